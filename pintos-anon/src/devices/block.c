@@ -3,8 +3,14 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
+/* Number of buckets in latency histograms.  Bucket I counts
+   requests that took 2**I to 2**(I+1) - 1 TSC cycles. */
+#define LATENCY_BUCKETS 40
+
 /* A block device. */
 struct block
   {
@@ -19,6 +25,18 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long read_req_cnt;    /* Number of read requests. */
+    unsigned long long write_req_cnt;   /* Number of write requests. */
+
+    /* Statistics for requests made directly on this device, as
+       opposed to passed on from a partition of it. */
+    unsigned long long class_cnt[BLOCK_IO_CLASS_CNT]; /* Sectors. */
+    unsigned long long read_latency[LATENCY_BUCKETS];  /* Histogram. */
+    unsigned long long write_latency[LATENCY_BUCKETS]; /* Histogram. */
+    unsigned in_flight;                 /* Requests submitted, not done. */
+    unsigned max_depth;                 /* Maximum of IN_FLIGHT. */
+    unsigned long long depth_sum;       /* Sum of IN_FLIGHT samples. */
+    unsigned long long depth_samples;   /* Number of samples. */
   };
 
 /* List of all block devices. */
@@ -113,6 +131,18 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Verifies that the CNT sectors starting at SECTOR are all
+   within BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector, size_t cnt)
+{
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", cnt=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt,
+           block->size);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +150,26 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multi (block, sector, 1, buffer, BLOCK_IO_OTHER);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes, and accounts for them as CLASS.  The driver may carry
+   this out as a single request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multi (struct block *block, block_sector_t sector, size_t cnt,
+                  void *buffer, enum block_io_class class)
+{
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  block_request_init (&r, false, sector, cnt, buffer, class, NULL, NULL);
+  block_submit (block, &r);
+  block_wait (&r);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +180,156 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multi (block, sector, 1, buffer, BLOCK_IO_OTHER);
+}
+
+/* Writes the CNT sectors starting at SECTOR on BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes, and
+   accounts for them as CLASS.  The driver may carry this out as
+   a single request.  Returns after the block device has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multi (struct block *block, block_sector_t sector, size_t cnt,
+                   const void *buffer, enum block_io_class class)
+{
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  block_request_init (&r, true, sector, cnt, (void *) buffer, class,
+                      NULL, NULL);
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Initializes request R to transfer the CNT sectors starting at
+   SECTOR to BUFFER (if WRITE is false) or from BUFFER (if WRITE
+   is true), accounted for as CLASS.  On completion, CALLBACK
+   will be called with R, or if CALLBACK is null, block_wait() on
+   R will return. */
+void
+block_request_init (struct block_request *r, bool write,
+                    block_sector_t sector, size_t cnt, void *buffer,
+                    enum block_io_class class,
+                    block_callback *callback, void *aux)
+{
+  ASSERT (r != NULL);
+  ASSERT (cnt > 0);
+  ASSERT (buffer != NULL);
+  ASSERT (class < BLOCK_IO_CLASS_CNT);
+
+  r->write = write;
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->callback = callback;
+  r->aux = aux;
+  r->class = class;
+  r->block = NULL;
+  r->driver = NULL;
+  sema_init (&r->done, 0);
+}
+
+/* Starts request R on BLOCK and returns, usually before the
+   transfer is done.  Requests to devices on different channels
+   or controllers may be carried out at the same time. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  check_sectors (block, r->sector, r->cnt);
+  if (r->write)
+    {
+      ASSERT (block->type != BLOCK_FOREIGN);
+      block->write_cnt += r->cnt;
+      block->write_req_cnt++;
+    }
+  else
+    {
+      block->read_cnt += r->cnt;
+      block->read_req_cnt++;
+    }
+
+  /* Charge R's class, queue depth and latency to the device it
+     was first submitted to. */
+  if (r->block == NULL)
+    {
+      enum intr_level old_level = intr_disable ();
+      r->block = block;
+      r->start_tsc = rdtsc ();
+      block->class_cnt[r->class] += r->cnt;
+      block->in_flight++;
+      if (block->in_flight > block->max_depth)
+        block->max_depth = block->in_flight;
+      block->depth_sum += block->in_flight;
+      block->depth_samples++;
+      intr_set_level (old_level);
+    }
+
+  r->driver = block->aux;
+  if (block->ops->submit != NULL)
+    block->ops->submit (block->aux, r);
+  else
+    {
+      uint8_t *buffer = r->buffer;
+      size_t i;
+
+      if (r->write && block->ops->write_multi != NULL)
+        block->ops->write_multi (block->aux, r->sector, r->cnt, buffer);
+      else if (!r->write && block->ops->read_multi != NULL)
+        block->ops->read_multi (block->aux, r->sector, r->cnt, buffer);
+      else
+        for (i = 0; i < r->cnt; i++)
+          {
+            if (r->write)
+              block->ops->write (block->aux, r->sector + i,
+                                 buffer + i * BLOCK_SECTOR_SIZE);
+            else
+              block->ops->read (block->aux, r->sector + i,
+                                buffer + i * BLOCK_SECTOR_SIZE);
+          }
+      block_complete (r);
+    }
+}
+
+/* Waits for request R, which must have been initialized without
+   a callback, to complete. */
+void
+block_wait (struct block_request *r)
+{
+  ASSERT (r->callback == NULL);
+  sema_down (&r->done);
+}
+
+/* Called by a driver when it has finished request R.  After
+   this, R belongs to its submitter again. */
+void
+block_complete (struct block_request *r)
+{
+  struct block *block = r->block;
+
+  if (block != NULL)
+    {
+      uint64_t cycles = rdtsc () - r->start_tsc;
+      unsigned long long *histogram = (r->write ? block->write_latency
+                                       : block->read_latency);
+      int bucket = 0;
+      enum intr_level old_level;
+
+      while (bucket < LATENCY_BUCKETS - 1 && cycles >> (bucket + 1) != 0)
+        bucket++;
+
+      old_level = intr_disable ();
+      block->in_flight--;
+      histogram[bucket]++;
+      intr_set_level (old_level);
+    }
+
+  if (r->callback != NULL)
+    r->callback (r);
+  else
+    sema_up (&r->done);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,6 +353,74 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Returns a human-readable name for I/O CLASS. */
+static const char *
+io_class_name (enum block_io_class class)
+{
+  static const char *io_class_names[BLOCK_IO_CLASS_CNT] =
+    {
+      "other",
+      "data",
+      "inode",
+      "free-map",
+      "swap",
+    };
+
+  ASSERT (class < BLOCK_IO_CLASS_CNT);
+  return io_class_names[class];
+}
+
+/* Prints the nonempty range of latency HISTOGRAM for requests
+   of the given KIND, if any. */
+static void
+print_latency (const char *kind, const unsigned long long *histogram)
+{
+  int first, last, i;
+
+  for (first = 0; first < LATENCY_BUCKETS; first++)
+    if (histogram[first] != 0)
+      break;
+  if (first >= LATENCY_BUCKETS)
+    return;
+  for (last = LATENCY_BUCKETS - 1; histogram[last] == 0; last--)
+    continue;
+
+  printf ("  %s latency, log2 cycles:", kind);
+  for (i = first; i <= last; i++)
+    printf (" %d:%llu", i, histogram[i]);
+  printf ("\n");
+}
+
+/* Prints statistics for BLOCK: sectors and requests, and for
+   requests made directly on BLOCK, bytes, sectors by I/O class,
+   queue depth, and latency histograms. */
+void
+block_print_device_stats (struct block *block)
+{
+  int i;
+
+  printf ("%s (%s): %llu reads in %llu requests, "
+          "%llu writes in %llu requests\n",
+          block->name, block_type_name (block->type),
+          block->read_cnt, block->read_req_cnt,
+          block->write_cnt, block->write_req_cnt);
+  if (block->depth_samples == 0)
+    return;
+
+  printf ("  %llu bytes read, %llu bytes written\n",
+          block->read_cnt * BLOCK_SECTOR_SIZE,
+          block->write_cnt * BLOCK_SECTOR_SIZE);
+  printf ("  sectors by class:");
+  for (i = 0; i < BLOCK_IO_CLASS_CNT; i++)
+    printf (" %s %llu", io_class_name (i), block->class_cnt[i]);
+  printf ("\n");
+  printf ("  queue depth: max %u, average %llu.%02llu\n",
+          block->max_depth, block->depth_sum / block->depth_samples,
+          block->depth_sum * 100 / block->depth_samples % 100);
+  print_latency ("read", block->read_latency);
+  print_latency ("write", block->write_latency);
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -170,11 +431,7 @@ block_print_stats (void)
     {
       struct block *block = block_by_role[i];
       if (block != NULL)
-        {
-          printf ("%s (%s): %llu reads, %llu writes\n",
-                  block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
-        }
+        block_print_device_stats (block);
     }
 }
 
@@ -200,6 +457,15 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->read_req_cnt = 0;
+  block->write_req_cnt = 0;
+  memset (block->class_cnt, 0, sizeof block->class_cnt);
+  memset (block->read_latency, 0, sizeof block->read_latency);
+  memset (block->write_latency, 0, sizeof block->write_latency);
+  block->in_flight = 0;
+  block->max_depth = 0;
+  block->depth_sum = 0;
+  block->depth_samples = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
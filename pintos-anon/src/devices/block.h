@@ -1,8 +1,11 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -41,6 +44,17 @@ enum block_type
 
 const char *block_type_name (enum block_type);
 
+/* What a block transfer is for, for statistics. */
+enum block_io_class
+  {
+    BLOCK_IO_OTHER,             /* Anything not listed below. */
+    BLOCK_IO_DATA,              /* File and directory contents. */
+    BLOCK_IO_INODE,             /* On-disk inodes. */
+    BLOCK_IO_FREE_MAP,          /* Free-sector bitmap. */
+    BLOCK_IO_SWAP,              /* Swapped-out pages. */
+    BLOCK_IO_CLASS_CNT
+  };
+
 /* Finding block devices. */
 struct block *block_get_role (enum block_type);
 void block_set_role (enum block_type, struct block *);
@@ -53,18 +67,73 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multi (struct block *, block_sector_t, size_t cnt, void *,
+                       enum block_io_class);
+void block_write_multi (struct block *, block_sector_t, size_t cnt,
+                        const void *, enum block_io_class);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous requests. */
+
+struct block_request;
+
+/* Called when a block request completes.  Runs in a kernel
+   thread belonging to the driver, so it may take locks but
+   should not wait for further I/O on the same device. */
+typedef void block_callback (struct block_request *);
+
+/* A request to transfer CNT sectors starting at SECTOR between a
+   block device and BUFFER without waiting for it.  The submitter
+   owns the request and must keep it alive until completion. */
+struct block_request
+  {
+    /* Set up by block_request_init(). */
+    bool write;                 /* True to write, false to read. */
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    enum block_io_class class;  /* What the transfer is for. */
+    block_callback *callback;   /* Called on completion, or null. */
+    void *aux;                  /* For CALLBACK's use. */
+
+    /* Owned by the block layer and the driver.  A partition
+       translates SECTOR before passing the request on. */
+    struct block *block;        /* Device first submitted to. */
+    uint64_t start_tsc;         /* Time of submission, in TSC cycles. */
+    struct list_elem elem;      /* Element in a driver queue. */
+    void *driver;               /* Driver's data for the device. */
+    int64_t deadline;           /* Scheduling deadline, in timer ticks. */
+    struct semaphore done;      /* Up'd on completion if no callback. */
+  };
+
+void block_request_init (struct block_request *, bool write,
+                         block_sector_t, size_t cnt, void *buffer,
+                         enum block_io_class, block_callback *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+void block_complete (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
+void block_print_device_stats (struct block *);
 
 /* Lower-level interface to block device drivers. */
 
+/* Driver operations.  READ_MULTI and WRITE_MULTI transfer CNT
+   consecutive sectors in one request.  SUBMIT queues a request
+   and returns at once, calling block_complete() when it is done.
+   Any of these may be null: the block layer then calls READ or
+   WRITE once per sector, and completes submitted requests
+   before block_submit() returns. */
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*read_multi) (void *aux, block_sector_t, size_t cnt, void *buffer);
+    void (*write_multi) (void *aux, block_sector_t, size_t cnt,
+                         const void *buffer);
+    void (*submit) (void *aux, struct block_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
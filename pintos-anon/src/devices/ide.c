@@ -4,14 +4,30 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/block.h"
+#include "devices/iosched.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the channels belong to a PCI bus-master IDE controller,
+   such as the Intel PIIX emulated by QEMU and Bochs, sectors are
+   transferred by DMA, so that the CPU only has to handle the
+   completion interrupt.  Otherwise, and for buffers that DMA
+   cannot reach, the CPU copies each sector through the data
+   register ("PIO").
+
+   Each disk has a queue of block requests, ordered by the I/O
+   scheduler, and each channel has a kernel thread that carries
+   them out one batch at a time, so that submitters need not
+   wait and both channels can transfer at once. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -30,10 +46,25 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus-master IDE port addresses.  See [PIIX] 2.7. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
+#define STA_DF 0x20             /* Device Fault. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
+
+/* Bus-master Command Register bits. */
+#define BMC_START 0x01          /* Start transfer. */
+#define BMC_READ 0x08           /* Transfer from disk to memory. */
+
+/* Bus-master Status Register bits. */
+#define BMS_ERROR 0x02          /* Transfer failed (write 1 to clear). */
+#define BMS_INTR 0x04           /* Interrupt raised (write 1 to clear). */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +80,29 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Most sectors that one command can transfer, the limit of
+   the 8-bit Sector Count register (in which 0 means 256). */
+#define MAX_SECTOR_CNT 256
+
+/* IDENTIFY DEVICE capabilities word and its DMA bit. */
+#define ID_CAPABILITIES 49
+#define ID_CAP_DMA 0x0100
+
+/* Physical Region Descriptor, one entry in the table that tells
+   the bus master where in physical memory to transfer to or
+   from.  A region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address, must be even. */
+    uint16_t size;              /* Bytes, with 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT or 0. */
+  };
+
+#define PRD_EOT 0x8000          /* Last entry in table. */
+#define PRD_CNT 16              /* Entries in each channel's table. */
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +111,8 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool use_dma;               /* Transfer by bus-master DMA? */
+    struct iosched sched;       /* Pending requests. */
   };
 
 /* An ATA channel (aka controller).
@@ -66,13 +122,21 @@ struct channel
     char name[8];               /* Name, e.g. "ide0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus-master I/O port, 0 if none. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
+    struct semaphore queued;    /* Up'd for each request queued. */
+    int next_dev;               /* Device to favor in next dispatch. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    uint8_t bm_status;          /* Bus-master status at last interrupt. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
+
+    /* PRD table.  Aligning it to its own size keeps it from
+       crossing a 64 kB boundary, which the bus master forbids. */
+    struct prd prdt[PRD_CNT]
+      __attribute__ ((aligned (PRD_CNT * sizeof (struct prd))));
   };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
@@ -81,14 +145,36 @@ static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+/* Transfer by DMA when the controller supports it?  Clearing
+   this before ide_init() forces PIO. */
+bool ide_dma = true;
+
+static uint16_t find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
-static void issue_pio_command (struct channel *, uint8_t command);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
+static void issue_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+/* Position within the sectors of a batch of requests. */
+struct sector_cursor
+  {
+    struct list_elem *elem;     /* Current request's elem. */
+    size_t idx;                 /* Sector index within request. */
+  };
+
+static uint8_t *cursor_next (struct sector_cursor *);
+static bool prepare_dma (struct channel *, struct sector_cursor *,
+                         size_t cnt);
+static bool dma_transfer (struct ata_disk *, block_sector_t, size_t cnt,
+                          uint8_t command);
+
+static void queue_request (struct ata_disk *, struct block_request *);
+static struct ata_disk *pick_disk (struct channel *);
+static void execute_batch (struct ata_disk *, struct list *batch);
+static thread_func channel_thread;
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -101,6 +187,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -123,7 +210,10 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+      c->bm_status = 0;
+      sema_init (&c->queued, 0);
+      c->next_dev = 0;
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -136,6 +226,8 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->use_dma = false;
+          iosched_init (&d->sched, d->name);
         }
 
       /* Register interrupt handler. */
@@ -148,6 +240,12 @@ ide_init (void)
       if (check_device_type (&c->devices[0]))
         check_device_type (&c->devices[1]);
 
+      /* Start carrying out requests.  Identification, below,
+         reads partition tables through the request queue, but
+         otherwise runs only while the channel's thread is
+         idle. */
+      thread_create (c->name, PRI_MAX, channel_thread, c);
+
       /* Read hard disk identity information. */
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
@@ -159,6 +257,35 @@ ide_init (void)
 
 static char *descramble_ata_string (char *, int size);
 
+/* Looks for a PCI IDE controller that can act as a bus master
+   on the two legacy channels.  If there is one, enables bus
+   mastering and returns the base of its bus-master I/O ports.
+   Otherwise, or if ide_dma is false, returns 0. */
+static uint16_t
+find_bus_master (void) 
+{
+  struct pci_addr addr;
+  uint32_t prog_if, bar, command;
+
+  if (!ide_dma || !pci_find_class (0x01, 0x01, &addr))
+    return 0;
+
+  /* Programming Interface bit 7 means bus master capable.  Bits 0
+     and 2 set would mean that a channel uses PCI native ports
+     rather than the legacy ones assumed above. */
+  prog_if = (pci_read_config (addr, PCI_REG_CLASS) >> 8) & 0xff;
+  bar = pci_read_config (addr, PCI_REG_BAR4);
+  if ((prog_if & 0x80) == 0 || (prog_if & 0x05) != 0 || (bar & 1) == 0)
+    return 0;
+
+  command = pci_read_config (addr, PCI_REG_COMMAND) & 0xffff;
+  pci_write_config (addr, PCI_REG_COMMAND,
+                    command | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+
+  printf ("ide: bus-master DMA at I/O port 0x%04"PRIx32"\n", bar & 0xfffc);
+  return bar & 0xfffc;
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void
@@ -272,7 +399,7 @@ identify_ata_device (struct ata_disk *d)
      indicating the device's response is ready, and read the data
      into our buffer. */
   select_device_wait (d);
-  issue_pio_command (c, CMD_IDENTIFY_DEVICE);
+  issue_command (c, CMD_IDENTIFY_DEVICE);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
     {
@@ -284,10 +411,13 @@ identify_ata_device (struct ata_disk *d)
   /* Calculate capacity.
      Read model name and serial number. */
   capacity = *(uint32_t *) &id[60 * 2];
+  d->use_dma = (c->bm_base != 0
+                && (*(uint16_t *) &id[ID_CAPABILITIES * 2] & ID_CAP_DMA));
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->use_dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -337,23 +467,47 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes, waiting until they arrive.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multi (void *d, block_sector_t sec_no, size_t cnt, void *buffer)
+{
+  struct block_request r;
+
+  block_request_init (&r, false, sec_no, cnt, buffer, BLOCK_IO_OTHER,
+                      NULL, NULL);
+  queue_request (d, &r);
+  block_wait (&r);
+}
+
+/* Writes the CNT sectors starting at SEC_NO on disk D from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multi (void *d, block_sector_t sec_no, size_t cnt,
+                 const void *buffer)
+{
+  struct block_request r;
+
+  block_request_init (&r, true, sec_no, cnt, (void *) buffer,
+                      BLOCK_IO_OTHER, NULL, NULL);
+  queue_request (d, &r);
+  block_wait (&r);
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read (void *d, block_sector_t sec_no, void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  ide_read_multi (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -362,38 +516,206 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  ide_write_multi (d, sec_no, 1, buffer);
+}
+
+/* Queues request R for disk D and returns without waiting. */
+static void
+ide_submit (void *d, struct block_request *r)
+{
+  queue_request (d, r);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multi,
+    ide_write_multi,
+    ide_submit
   };
-
+
+/* Request dispatch. */
+
+/* Adds request R for disk D to D's queue. */
+static void
+queue_request (struct ata_disk *d, struct block_request *r) 
+{
+  enum intr_level old_level;
+
+  ASSERT (r->cnt > 0);
+
+  r->driver = d;
+  old_level = intr_disable ();
+  iosched_add (&d->sched, r);
+  intr_set_level (old_level);
+  sema_up (&d->channel->queued);
+}
+
+/* Carries out the requests queued on channel C_'s disks, one
+   batch at a time, completing each batch before starting the
+   next. */
+static void
+channel_thread (void *c_) 
+{
+  struct channel *c = c_;
+
+  for (;;) 
+    {
+      struct ata_disk *d;
+      struct list batch;
+      enum intr_level old_level;
+
+      sema_down (&c->queued);
+      list_init (&batch);
+      old_level = intr_disable ();
+      d = pick_disk (c);
+      if (d != NULL)
+        iosched_next (&d->sched, &batch, MAX_SECTOR_CNT);
+      intr_set_level (old_level);
+
+      /* An earlier batch may have merged the request whose
+         arrival we were woken for. */
+      if (d == NULL)
+        continue;
+
+      execute_batch (d, &batch);
+      while (!list_empty (&batch))
+        block_complete (list_entry (list_pop_front (&batch),
+                                    struct block_request, elem));
+    }
+}
+
+/* Returns the disk on channel C to dispatch from next, or a
+   null pointer if neither has requests queued.  Alternates
+   between the disks when both are busy, unless only one of them
+   has a request past its deadline. */
+static struct ata_disk *
+pick_disk (struct channel *c) 
+{
+  struct ata_disk *d = &c->devices[c->next_dev];
+  struct ata_disk *other = &c->devices[!c->next_dev];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (iosched_empty (&d->sched)
+      || (iosched_expired (&other->sched) && !iosched_expired (&d->sched)))
+    {
+      struct ata_disk *tmp = d;
+      d = other;
+      other = tmp;
+    }
+  if (iosched_empty (&d->sched))
+    return NULL;
+
+  c->next_dev = other->dev_no;
+  return d;
+}
+
+/* Returns the buffer for the sector at CURSOR and advances
+   CURSOR to the next sector. */
+static uint8_t *
+cursor_next (struct sector_cursor *cursor) 
+{
+  struct block_request *r = list_entry (cursor->elem,
+                                        struct block_request, elem);
+  uint8_t *buffer = (uint8_t *) r->buffer + cursor->idx * BLOCK_SECTOR_SIZE;
+
+  if (++cursor->idx >= r->cnt) 
+    {
+      cursor->elem = list_next (cursor->elem);
+      cursor->idx = 0;
+    }
+  return buffer;
+}
+
+/* Transfers the sectors of the requests in BATCH, which are in
+   the same direction and consecutive, on disk D.  Each run of up
+   to MAX_SECTOR_CNT sectors takes a single command.  Panics if
+   the disk reports an error. */
+static void
+execute_batch (struct ata_disk *d, struct list *batch) 
+{
+  struct channel *c = d->channel;
+  struct block_request *first = list_entry (list_front (batch),
+                                            struct block_request, elem);
+  const char *op = first->write ? "write" : "read";
+  struct sector_cursor cursor;
+  block_sector_t sec_no = first->sector;
+  size_t cnt = 0;
+  struct list_elem *e;
+
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    cnt += list_entry (e, struct block_request, elem)->cnt;
+  cursor.elem = list_begin (batch);
+  cursor.idx = 0;
+
+  while (cnt > 0) 
+    {
+      size_t run = cnt < MAX_SECTOR_CNT ? cnt : MAX_SECTOR_CNT;
+      struct sector_cursor start = cursor;
+      size_t i;
+
+      if (d->use_dma && prepare_dma (c, &cursor, run)) 
+        {
+          if (!dma_transfer (d, sec_no, run,
+                             first->write ? CMD_WRITE_DMA : CMD_READ_DMA))
+            PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+                   d->name, op, sec_no);
+        }
+      else if (!first->write)
+        {
+          /* The disk interrupts once per sector, when that sector
+             is ready to be read from the data register. */
+          cursor = start;
+          select_sector (d, sec_no, run);
+          issue_command (c, CMD_READ_SECTOR_RETRY);
+          for (i = 0; i < run; i++) 
+            {
+              sema_down (&c->completion_wait);
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              input_sector (c, cursor_next (&cursor));
+            }
+        }
+      else 
+        {
+          /* The disk interrupts once per sector, when it has
+             accepted that sector's data. */
+          cursor = start;
+          select_sector (d, sec_no, run);
+          issue_command (c, CMD_WRITE_SECTOR_RETRY);
+          for (i = 0; i < run; i++) 
+            {
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              output_sector (c, cursor_next (&cursor));
+              sema_down (&c->completion_wait);
+            }
+        }
+
+      sec_no += run;
+      cnt -= run;
+    }
+}
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection
+   registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTOR_CNT);
+  ASSERT (sec_no < (1UL << 28) && cnt <= (1UL << 28) - sec_no);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -404,7 +726,7 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
-issue_pio_command (struct channel *c, uint8_t command) 
+issue_command (struct channel *c, uint8_t command) 
 {
   /* Interrupts must be enabled or our semaphore will never be
      up'd by the completion handler. */
@@ -429,6 +751,95 @@ output_sector (struct channel *c, const void *sector)
 {
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
+
+/* Appends the SIZE bytes at physical address PHYS to channel
+   C's PRD table, which has *CNT entries so far, splitting them
+   at 64 kB boundaries and extending the last entry if it ends
+   at PHYS.  Returns false if the table overflows. */
+static bool
+add_prd (struct channel *c, size_t *cnt, uintptr_t phys, size_t size) 
+{
+  while (size > 0) 
+    {
+      size_t chunk = 0x10000 - phys % 0x10000;
+      struct prd *last = *cnt > 0 ? &c->prdt[*cnt - 1] : NULL;
+      size_t last_size = last != NULL && last->size == 0 ? 0x10000
+                         : last != NULL ? last->size : 0;
+
+      if (chunk > size)
+        chunk = size;
+      if (last != NULL && last->addr + last_size == phys
+          && phys % 0x10000 != 0)
+        last->size = last_size + chunk;
+      else if (*cnt < PRD_CNT)
+        {
+          c->prdt[*cnt].addr = phys;
+          c->prdt[*cnt].size = chunk;
+          c->prdt[*cnt].flags = 0;
+          ++*cnt;
+        }
+      else
+        return false;
+      phys += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
+/* Fills in channel C's PRD table to describe the buffers for
+   the CNT sectors starting at CURSOR, and advances CURSOR past
+   them.  Returns true if successful, false if the bus master
+   cannot reach a buffer: it is not in the kernel's mapping of
+   physical memory, it is at an odd address, or the buffers need
+   more than PRD_CNT regions. */
+static bool
+prepare_dma (struct channel *c, struct sector_cursor *cursor, size_t cnt) 
+{
+  size_t prd_cnt = 0;
+
+  ASSERT (cnt > 0);
+
+  while (cnt-- > 0) 
+    {
+      const uint8_t *sector = cursor_next (cursor);
+
+      if (!is_kernel_vaddr (sector)
+          || !is_kernel_vaddr (sector + BLOCK_SECTOR_SIZE - 1)
+          || (uintptr_t) sector % 2 != 0
+          || !add_prd (c, &prd_cnt, vtop (sector), BLOCK_SECTOR_SIZE))
+        return false;
+    }
+  c->prdt[prd_cnt - 1].flags = PRD_EOT;
+  return true;
+}
+
+/* Has disk D carry out COMMAND, either CMD_READ_DMA or
+   CMD_WRITE_DMA, on the CNT sectors starting at SEC_NO, using
+   the PRD table already set up by prepare_dma().  Waits for the
+   completion interrupt and returns true if the transfer
+   succeeded. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+              uint8_t command) 
+{
+  struct channel *c = d->channel;
+  uint8_t direction = command == CMD_READ_DMA ? BMC_READ : 0;
+  uint8_t status;
+
+  outb (reg_bm_command (c), direction);
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_status (c), BMS_INTR | BMS_ERROR);
+
+  select_sector (d, sec_no, cnt);
+  issue_command (c, command);
+  outb (reg_bm_command (c), direction | BMC_START);
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), direction);
+
+  status = inb (reg_alt_status (c));
+  return ((c->bm_status & BMS_ERROR) == 0
+          && (status & (STA_BSY | STA_DF | STA_ERR)) == 0);
+}
 
 /* Low-level ATA primitives. */
 
@@ -514,6 +925,12 @@ interrupt_handler (struct intr_frame *f)
         if (c->expecting_interrupt) 
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
+            if (c->bm_base != 0) 
+              {
+                /* Latch and clear the bus master's status. */
+                c->bm_status = inb (reg_bm_status (c));
+                outb (reg_bm_status (c), c->bm_status);
+              }
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
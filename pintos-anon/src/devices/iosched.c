@@ -0,0 +1,247 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+
+/* The code in this file decides the order in which a disk
+   driver carries out queued block requests.  Two policies are
+   available:
+
+   - "fifo" dispatches requests in arrival order, one at a time.
+
+   - "deadline" keeps requests sorted by sector and sweeps
+     upward through them from the last sector dispatched,
+     wrapping around to the lowest sector at the top (C-LOOK).
+     Requests that continue the one being dispatched, in the
+     same direction, are merged into a single batch.  Each
+     request also gets a deadline when it is queued, and once
+     any request's deadline passes the oldest such request goes
+     next, so that a stream of nearby requests cannot starve a
+     distant one. */
+
+/* Deadlines, in timer ticks after queuing.  Writes can usually
+   wait longer than reads, since no thread is blocked on them. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (TIMER_FREQ * 5)
+
+/* An I/O scheduling policy. */
+struct policy
+  {
+    const char *name;           /* Name on the kernel command line. */
+    bool merge;                 /* Merge adjacent requests? */
+
+    /* Adds R to S's queue. */
+    void (*add) (struct iosched *s, struct block_request *r);
+
+    /* Returns the request in S's non-empty queue to dispatch
+       next. */
+    struct block_request *(*pick) (struct iosched *s);
+  };
+
+static void fifo_add (struct iosched *, struct block_request *);
+static struct block_request *fifo_pick (struct iosched *);
+static void deadline_add (struct iosched *, struct block_request *);
+static struct block_request *deadline_pick (struct iosched *);
+
+static const struct policy policies[] =
+  {
+    {"fifo", false, fifo_add, fifo_pick},
+    {"deadline", true, deadline_add, deadline_pick},
+  };
+#define POLICY_CNT (sizeof policies / sizeof *policies)
+
+/* Policy in use. */
+static const struct policy *policy = &policies[1];
+
+/* List of all schedulers, for statistics. */
+static struct list all_scheds = LIST_INITIALIZER (all_scheds);
+
+/* Selects the policy with the given NAME.  Must be called before
+   any requests are queued.  Returns true if successful, false if
+   there is no such policy. */
+bool
+iosched_select (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < POLICY_CNT; i++)
+    if (!strcmp (name, policies[i].name))
+      {
+        policy = &policies[i];
+        return true;
+      }
+  return false;
+}
+
+/* Initializes S as an empty queue for the device with the given
+   NAME, which must remain valid for S's lifetime. */
+void
+iosched_init (struct iosched *s, const char *name)
+{
+  s->name = name;
+  list_init (&s->queue);
+  s->head = 0;
+  s->dispatch_cnt = 0;
+  s->merge_cnt = 0;
+  s->expire_cnt = 0;
+  s->seek_distance = 0;
+  list_push_back (&all_scheds, &s->elem);
+}
+
+/* Returns true if S has no pending requests. */
+bool
+iosched_empty (struct iosched *s)
+{
+  return list_empty (&s->queue);
+}
+
+/* Returns true if any request in S is past its deadline. */
+bool
+iosched_expired (struct iosched *s)
+{
+  int64_t now = timer_ticks ();
+  struct list_elem *e;
+
+  for (e = list_begin (&s->queue); e != list_end (&s->queue);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->deadline <= now)
+      return true;
+  return false;
+}
+
+/* Queues request R in S. */
+void
+iosched_add (struct iosched *s, struct block_request *r)
+{
+  r->deadline = timer_ticks () + (r->write ? WRITE_EXPIRE : READ_EXPIRE);
+  policy->add (s, r);
+}
+
+/* Moves the requests that the driver should carry out next from
+   S to BATCH, which should be empty.  The requests in BATCH are
+   in the same direction and cover consecutive sectors, starting
+   from the first request's, so that the driver can transfer
+   them with a single command.  Merging stops short of MAX_CNT
+   sectors, although a single request may exceed it.  Returns
+   the number of sectors in BATCH, or 0 if S is empty. */
+size_t
+iosched_next (struct iosched *s, struct list *batch, size_t max_cnt)
+{
+  struct block_request *first;
+  struct list_elem *e;
+  block_sector_t end;
+  size_t cnt;
+
+  if (list_empty (&s->queue))
+    return 0;
+
+  first = policy->pick (s);
+  e = list_remove (&first->elem);
+  list_push_back (batch, &first->elem);
+  cnt = first->cnt;
+  end = first->sector + first->cnt;
+
+  if (policy->merge)
+    while (e != list_end (&s->queue))
+      {
+        struct block_request *r = list_entry (e, struct block_request, elem);
+        if (r->sector != end || r->write != first->write
+            || r->driver != first->driver || cnt + r->cnt > max_cnt)
+          break;
+
+        e = list_remove (&r->elem);
+        list_push_back (batch, &r->elem);
+        cnt += r->cnt;
+        end += r->cnt;
+        s->merge_cnt++;
+      }
+
+  s->seek_distance += (first->sector > s->head
+                       ? first->sector - s->head
+                       : s->head - first->sector);
+  s->head = end;
+  s->dispatch_cnt++;
+  return cnt;
+}
+
+/* Prints statistics for each scheduler that dispatched any
+   requests. */
+void
+iosched_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_scheds); e != list_end (&all_scheds);
+       e = list_next (e))
+    {
+      struct iosched *s = list_entry (e, struct iosched, elem);
+      if (s->dispatch_cnt > 0)
+        printf ("%s: %llu dispatches (%s), %llu merges, %llu expired, "
+                "seek distance %llu sectors\n",
+                s->name, s->dispatch_cnt, policy->name, s->merge_cnt,
+                s->expire_cnt, s->seek_distance);
+    }
+}
+
+/* FIFO policy. */
+
+static void
+fifo_add (struct iosched *s, struct block_request *r)
+{
+  list_push_back (&s->queue, &r->elem);
+}
+
+static struct block_request *
+fifo_pick (struct iosched *s)
+{
+  return list_entry (list_front (&s->queue), struct block_request, elem);
+}
+
+/* Deadline policy. */
+
+/* Orders block requests by first sector. */
+static bool
+sector_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return a->sector < b->sector;
+}
+
+static void
+deadline_add (struct iosched *s, struct block_request *r)
+{
+  list_insert_ordered (&s->queue, &r->elem, sector_less, NULL);
+}
+
+static struct block_request *
+deadline_pick (struct iosched *s)
+{
+  int64_t now = timer_ticks ();
+  struct block_request *oldest = NULL;
+  struct block_request *next = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&s->queue); e != list_end (&s->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (oldest == NULL || r->deadline < oldest->deadline)
+        oldest = r;
+      if (next == NULL && r->sector >= s->head)
+        next = r;
+    }
+
+  if (oldest->deadline <= now)
+    {
+      s->expire_cnt++;
+      return oldest;
+    }
+  else if (next != NULL)
+    return next;
+  else
+    return list_entry (list_front (&s->queue), struct block_request, elem);
+}
@@ -0,0 +1,35 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Queue of pending block requests for one disk, ordered by the
+   I/O scheduling policy selected with iosched_select().  Callers
+   must serialize access to each queue, e.g. by disabling
+   interrupts. */
+struct iosched
+  {
+    struct list_elem elem;              /* Element in all_scheds. */
+    const char *name;                   /* Device name, for statistics. */
+    struct list queue;                  /* Pending struct block_requests. */
+    block_sector_t head;                /* Sector after last dispatch. */
+
+    /* Statistics. */
+    unsigned long long dispatch_cnt;    /* Batches dispatched. */
+    unsigned long long merge_cnt;       /* Requests merged into a batch. */
+    unsigned long long expire_cnt;      /* Dispatched past deadline. */
+    unsigned long long seek_distance;   /* Sectors between batches. */
+  };
+
+bool iosched_select (const char *policy);
+void iosched_init (struct iosched *, const char *name);
+bool iosched_empty (struct iosched *);
+bool iosched_expired (struct iosched *);
+void iosched_add (struct iosched *, struct block_request *);
+size_t iosched_next (struct iosched *, struct list *batch, size_t max_cnt);
+void iosched_print_stats (void);
+
+#endif /* devices/iosched.h */
@@ -317,8 +317,46 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads the CNT sectors starting at SECTOR from partition P
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void
+partition_read_multi (void *p_, block_sector_t sector, size_t cnt,
+                      void *buffer)
+{
+  struct partition *p = p_;
+  block_read_multi (p->block, p->start + sector, cnt, buffer,
+                    BLOCK_IO_OTHER);
+}
+
+/* Writes the CNT sectors starting at SECTOR on partition P from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block has acknowledged receiving the
+   data. */
+static void
+partition_write_multi (void *p_, block_sector_t sector, size_t cnt,
+                       const void *buffer)
+{
+  struct partition *p = p_;
+  block_write_multi (p->block, p->start + sector, cnt, buffer,
+                     BLOCK_IO_OTHER);
+}
+
+/* Passes request R on partition P to the underlying block
+   device, translating its sectors. */
+static void
+partition_submit (void *p_, struct block_request *r)
+{
+  struct partition *p = p_;
+  r->sector += p->start;
+  block_submit (p->block, r);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multi,
+    partition_write_multi,
+    partition_submit
   };
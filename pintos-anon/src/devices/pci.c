@@ -0,0 +1,83 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* The code in this file accesses PCI configuration space through
+   configuration mechanism #1, the pair of I/O ports that every
+   PC chipset since the early 1990s provides.  See [PCI] 3.2.2.3.2. */
+
+/* Configuration mechanism #1 ports. */
+#define CONFIG_ADDRESS 0xcf8
+#define CONFIG_DATA 0xcfc
+
+/* Value of the Vendor ID register for an absent function. */
+#define NO_VENDOR 0xffff
+
+/* Header Type bit indicating a multi-function device. */
+#define HEADER_MULTI_FUNC 0x00800000
+
+/* Selects register REG in ADDR's configuration space. */
+static void
+select_config (struct pci_addr addr, uint8_t reg) 
+{
+  ASSERT (addr.dev < 32 && addr.func < 8);
+  ASSERT (reg % 4 == 0);
+
+  outl (CONFIG_ADDRESS, (0x80000000u | (addr.bus << 16) | (addr.dev << 11)
+                         | (addr.func << 8) | reg));
+}
+
+/* Returns the 32-bit configuration register REG of the PCI
+   function at ADDR. */
+uint32_t
+pci_read_config (struct pci_addr addr, uint8_t reg) 
+{
+  select_config (addr, reg);
+  return inl (CONFIG_DATA);
+}
+
+/* Sets the 32-bit configuration register REG of the PCI function
+   at ADDR to VALUE. */
+void
+pci_write_config (struct pci_addr addr, uint8_t reg, uint32_t value) 
+{
+  select_config (addr, reg);
+  outl (CONFIG_DATA, value);
+}
+
+/* Scans every PCI bus for the first function with the given
+   CLASS and SUBCLASS.  If one is found, stores its address in
+   *ADDR and returns true; otherwise returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *addr) 
+{
+  unsigned bus, dev, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func = 0; func < 8; func++) 
+        {
+          struct pci_addr a = {bus, dev, func};
+          uint32_t class_reg;
+
+          if ((pci_read_config (a, PCI_REG_ID) & 0xffff) == NO_VENDOR) 
+            {
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          class_reg = pci_read_config (a, PCI_REG_CLASS);
+          if ((class_reg >> 24) == class
+              && ((class_reg >> 16) & 0xff) == subclass) 
+            {
+              *addr = a;
+              return true;
+            }
+
+          if (func == 0
+              && !(pci_read_config (a, PCI_REG_HEADER) & HEADER_MULTI_FUNC))
+            break;
+        }
+  return false;
+}
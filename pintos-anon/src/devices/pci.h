@@ -0,0 +1,30 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A PCI function's address in configuration space. */
+struct pci_addr
+  {
+    uint8_t bus;                /* Bus number. */
+    uint8_t dev;                /* Device number, 0...31. */
+    uint8_t func;               /* Function number, 0...7. */
+  };
+
+/* Configuration space register offsets.  See [PCI] 6.1. */
+#define PCI_REG_ID 0x00         /* Vendor ID, Device ID. */
+#define PCI_REG_COMMAND 0x04    /* Command, Status. */
+#define PCI_REG_CLASS 0x08      /* Revision, Prog IF, Subclass, Class. */
+#define PCI_REG_HEADER 0x0c     /* ..., Header Type, ... */
+#define PCI_REG_BAR4 0x20       /* Base Address Register 4. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001               /* Respond to I/O space. */
+#define PCI_CMD_BUS_MASTER 0x0004       /* May act as bus master. */
+
+uint32_t pci_read_config (struct pci_addr, uint8_t reg);
+void pci_write_config (struct pci_addr, uint8_t reg, uint32_t value);
+bool pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *);
+
+#endif /* devices/pci.h */
@@ -0,0 +1,143 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* The code in this file is a block device whose sectors live in
+   kernel memory, for benchmarking file system code without the
+   cost and variance of an emulated disk.  Its contents do not
+   survive a reboot, so it must be formatted (with -f) when it
+   is used as the file system device.
+
+   The memory comes from the kernel pool one page at a time, so
+   that a large RAM disk does not need contiguous pages. */
+
+/* Sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Size of the RAM disk to create, in kB, or 0 for none. */
+size_t ramdisk_kb;
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    size_t page_cnt;            /* Number of pages. */
+    uint8_t **pages;            /* Array of PAGE_CNT pages. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Creates and registers the RAM disk "ram0" if ramdisk_kb is
+   nonzero.  Panics if there is not enough memory. */
+void
+ramdisk_init (void) 
+{
+  struct ramdisk *rd;
+  char extra_info[32];
+  size_t i;
+
+  if (ramdisk_kb == 0)
+    return;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("ramdisk: out of memory");
+  rd->page_cnt = DIV_ROUND_UP (ramdisk_kb * 1024, PGSIZE);
+  rd->pages = malloc (rd->page_cnt * sizeof *rd->pages);
+  if (rd->pages == NULL)
+    PANIC ("ramdisk: out of memory");
+  for (i = 0; i < rd->page_cnt; i++) 
+    {
+      rd->pages[i] = palloc_get_page (PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("ramdisk: out of memory after %zu of %zu pages",
+               i, rd->page_cnt);
+    }
+
+  snprintf (extra_info, sizeof extra_info, "%zu pages of RAM", rd->page_cnt);
+  block_register ("ram0", BLOCK_RAW, extra_info,
+                  rd->page_cnt * PAGE_SECTORS, &ramdisk_operations, rd);
+}
+
+/* Returns the address of sector SEC_NO in RD. */
+static uint8_t *
+sector_addr (struct ramdisk *rd, block_sector_t sec_no) 
+{
+  ASSERT (sec_no / PAGE_SECTORS < rd->page_cnt);
+  return (rd->pages[sec_no / PAGE_SECTORS]
+          + (sec_no % PAGE_SECTORS) * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from RAM disk RD_
+   into BUFFER, a page's worth of sectors at a time. */
+static void
+ramdisk_read_multi (void *rd_, block_sector_t sec_no, size_t cnt,
+                    void *buffer_) 
+{
+  struct ramdisk *rd = rd_;
+  uint8_t *buffer = buffer_;
+
+  while (cnt > 0) 
+    {
+      size_t run = PAGE_SECTORS - sec_no % PAGE_SECTORS;
+      if (run > cnt)
+        run = cnt;
+      memcpy (buffer, sector_addr (rd, sec_no), run * BLOCK_SECTOR_SIZE);
+      sec_no += run;
+      buffer += run * BLOCK_SECTOR_SIZE;
+      cnt -= run;
+    }
+}
+
+/* Writes the CNT sectors starting at SEC_NO on RAM disk RD_ from
+   BUFFER, a page's worth of sectors at a time. */
+static void
+ramdisk_write_multi (void *rd_, block_sector_t sec_no, size_t cnt,
+                     const void *buffer_) 
+{
+  struct ramdisk *rd = rd_;
+  const uint8_t *buffer = buffer_;
+
+  while (cnt > 0) 
+    {
+      size_t run = PAGE_SECTORS - sec_no % PAGE_SECTORS;
+      if (run > cnt)
+        run = cnt;
+      memcpy (sector_addr (rd, sec_no), buffer, run * BLOCK_SECTOR_SIZE);
+      sec_no += run;
+      buffer += run * BLOCK_SECTOR_SIZE;
+      cnt -= run;
+    }
+}
+
+/* Reads sector SEC_NO from RAM disk RD into BUFFER. */
+static void
+ramdisk_read (void *rd, block_sector_t sec_no, void *buffer) 
+{
+  ramdisk_read_multi (rd, sec_no, 1, buffer);
+}
+
+/* Writes sector SEC_NO on RAM disk RD from BUFFER. */
+static void
+ramdisk_write (void *rd, block_sector_t sec_no, const void *buffer) 
+{
+  ramdisk_write_multi (rd, sec_no, 1, buffer);
+}
+
+/* RAM disk transfers finish before they return, so there is no
+   `submit' operation: the block layer completes requests
+   itself. */
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multi,
+    ramdisk_write_multi,
+    NULL
+  };
@@ -0,0 +1,11 @@
+#ifndef DEVICES_RAMDISK_H
+#define DEVICES_RAMDISK_H
+
+#include <stddef.h>
+
+/* Size of the RAM disk to create, in kB, or 0 for none. */
+extern size_t ramdisk_kb;
+
+void ramdisk_init (void);
+
+#endif /* devices/ramdisk.h */
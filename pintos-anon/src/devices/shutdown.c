@@ -4,13 +4,18 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "devices/iosched.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #endif
 
@@ -20,6 +25,10 @@
 /* How to shut down when shutdown() is called. */
 static enum shutdown_type how = SHUTDOWN_NONE;
 
+/* Set by shutdown_panic(). */
+static bool panicking;
+
+static void flush_filesys (void);
 static void print_stats (void);
 
 /* Shuts down the machine in the way configured by
@@ -35,6 +44,7 @@ shutdown (void)
       break;
 
     case SHUTDOWN_REBOOT:
+      flush_filesys ();
       shutdown_reboot ();
       break;
 
@@ -44,6 +54,15 @@ shutdown (void)
     }
 }
 
+/* Shuts down like shutdown(), but without writing back the file
+   system.  Called by debug_panic(). */
+void
+shutdown_panic (void)
+{
+  panicking = true;
+  shutdown ();
+}
+
 /* Sets TYPE as the way that machine will shut down when Pintos
    execution is complete. */
 void
@@ -90,10 +109,7 @@ shutdown_power_off (void)
   const char s[] = "Shutdown";
   const char *p;
 
-#ifdef FILESYS
-  filesys_done ();
-#endif
-
+  flush_filesys ();
   print_stats ();
 
   printf ("Powering off...\n");
@@ -124,14 +140,32 @@ shutdown_power_off (void)
   for (;;);
 }
 
+/* Writes back the file system's dirty data, if it is safe to.
+   Writing back waits for the disk and takes locks, so it is
+   skipped in interrupt context and after a kernel panic, which
+   may have happened on the thread that completes disk
+   requests. */
+static void
+flush_filesys (void)
+{
+#ifdef FILESYS
+  if (!panicking && !intr_context ())
+    filesys_done ();
+#endif
+}
+
 /* Print statistics about Pintos execution. */
 static void
 print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lockstat_print ();
+  kmem_print_stats ();
 #ifdef FILESYS
+  cache_print_stats ();
   block_print_stats ();
+  iosched_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
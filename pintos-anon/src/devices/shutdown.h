@@ -12,6 +12,7 @@ enum shutdown_type
   };
 
 void shutdown (void);
+void shutdown_panic (void);
 void shutdown_configure (enum shutdown_type);
 void shutdown_reboot (void) NO_RETURN;
 void shutdown_power_off (void) NO_RETURN;
@@ -4,6 +4,7 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
@@ -20,6 +21,19 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* If true, stop the periodic tick while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless idle.  One timer tick is TICK_CYCLES PIT cycles, and
+   the 16-bit PIT counter can count at most MAX_IDLE_TICKS of
+   them in one shot. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define MAX_IDLE_TICKS ((65535 - TICK_CYCLES) / TICK_CYCLES + 1)
+static int idle_shot_ticks;     /* Ticks covered by one-shot, or 0. */
+static unsigned idle_shot_first; /* PIT cycles left in first tick. */
+static unsigned idle_shot_count; /* PIT cycles in the whole shot. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -30,26 +44,74 @@ static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-/* alarm thread sleeping list */
-static struct list alarm_list;
-/* return true if a's wake_up_time < b's */
-bool alarm_less_func (const struct list_elem *a, 
-                      const struct list_elem *b, void *aux){
-  struct thread *thread_a = list_entry(a, struct thread, alarm_elem);
-  struct thread *thread_b = list_entry(b, struct thread, alarm_elem);
-  return thread_a->wake_up_time<thread_b->wake_up_time;
-}
+/* Hierarchical timing wheel holding every armed alarm.
+
+   Level L has WHEEL_SIZE slots, each covering WHEEL_SIZE^L
+   ticks, so the wheel spans WHEEL_SIZE^WHEEL_LEVELS ticks in
+   all.  An alarm goes into the lowest level whose span covers
+   its distance from wheel_time, which is O(1).  Each tick fires
+   the whole level 0 slot for that tick; whenever the level 0
+   index wraps around, the next slot of level 1 is cascaded down
+   (and likewise up the hierarchy), so every alarm is moved at
+   most WHEEL_LEVELS - 1 times before it fires.  Alarms further
+   out than the whole wheel wait in the last level and are
+   re-filed each time their slot is cascaded. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick the wheel will process.  Every alarm that expires
+   before this tick has already fired. */
+static int64_t wheel_time;
+
+static void wheel_insert (struct alarm *);
+static void wheel_advance (int64_t now);
+
+/* Timer interrupt handler cycle counts. */
+static struct timer_cycle_stats cycle_stats;
+
+static void wake_sleeper (void *t_);
+
+/* Kernel timers whose alarms have fired but whose callbacks the
+   timer thread has not yet run, and a semaphore that counts
+   them. */
+static struct list expired_timers;
+static struct semaphore expired_sema;
+
+static void kernel_timer_expire (void *timer_);
+static thread_func timer_thread;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
-  list_init(&alarm_list);
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_time = ticks + 1;
+  list_init (&expired_timers);
+  sema_init (&expired_sema, 0);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
+/* Starts the kernel thread that runs kernel timer callbacks.
+   Must be called after thread_start().  Kernel timers may be
+   armed before this, but their callbacks will not run until
+   then. */
+void
+timer_init_callbacks (void) 
+{
+  thread_create ("timerd", PRI_MAX, timer_thread, NULL);
+}
+
 /* Calibrates loops_per_tick, used to implement brief delays. */
 void
 timer_calibrate (void) 
@@ -108,16 +170,23 @@ timer_sleep (int64_t ticks)
   ASSERT (intr_get_level () == INTR_ON);
   enum intr_level old_level = intr_disable ();
 
-  /* add current thread to list and block it;
+  /* arm current thread's alarm and block it;
     thread_block() will incur schedule() */
   struct thread *cur = thread_current();
-  cur->wake_up_time=ticks+start;
-  list_insert_ordered(&alarm_list,&cur->alarm_elem,alarm_less_func,NULL);
+  alarm_init (&cur->alarm, wake_sleeper, cur);
+  alarm_arm (&cur->alarm, start + ticks);
   
   thread_block();
   intr_set_level (old_level);
 }
 
+/* Alarm function for timer_sleep(): wakes up sleeping thread T_. */
+static void
+wake_sleeper (void *t_)
+{
+  thread_unblock (t_);
+}
+
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void
@@ -187,25 +256,377 @@ timer_print_stats (void)
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
-
+
+/* Initializes ALARM to call FUNC(AUX) when it fires.  ALARM is
+   not armed. */
+void
+alarm_init (struct alarm *alarm, alarm_func *func, void *aux)
+{
+  ASSERT (alarm != NULL);
+  ASSERT (func != NULL);
+
+  alarm->expires = 0;
+  alarm->func = func;
+  alarm->aux = aux;
+  alarm->armed = false;
+}
+
+/* Arms ALARM to fire on the first tick at or after EXPIRES,
+   which should be based on timer_ticks().  If ALARM is already
+   armed, it is moved to the new expiry time.  Takes constant
+   time and may be called from an interrupt handler. */
+void
+alarm_arm (struct alarm *alarm, int64_t expires)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (alarm->armed)
+    list_remove (&alarm->elem);
+  alarm->expires = expires;
+  alarm->armed = true;
+  wheel_insert (alarm);
+
+  intr_set_level (old_level);
+}
+
+/* Disarms ALARM.  Returns true if it was armed, false if it had
+   already fired or was never armed.  Takes constant time and may
+   be called from an interrupt handler. */
+bool
+alarm_cancel (struct alarm *alarm)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_armed = alarm->armed;
+
+  if (was_armed)
+    {
+      list_remove (&alarm->elem);
+      alarm->armed = false;
+    }
+
+  intr_set_level (old_level);
+  return was_armed;
+}
+
+/* Initializes TIMER to call FUNC(AUX) from the timer thread when
+   it expires.  TIMER is not armed. */
+void
+timer_setup (struct kernel_timer *timer, kernel_timer_func *func, void *aux)
+{
+  ASSERT (timer != NULL);
+  ASSERT (func != NULL);
+
+  alarm_init (&timer->alarm, kernel_timer_expire, timer);
+  timer->func = func;
+  timer->aux = aux;
+  timer->expired = false;
+}
+
+/* Arms TIMER, which must not be pending, to expire on the first
+   tick at or after EXPIRES.  May be called from an interrupt
+   handler. */
+void
+timer_add (struct kernel_timer *timer, int64_t expires)
+{
+  ASSERT (!timer_pending (timer));
+  timer_mod (timer, expires);
+}
+
+/* Moves TIMER's expiry to EXPIRES, arming it if it is not
+   pending.  Returns true if TIMER was pending.  May be called
+   from an interrupt handler. */
+bool
+timer_mod (struct kernel_timer *timer, int64_t expires)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = timer_del (timer);
+
+  alarm_arm (&timer->alarm, expires);
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Disarms TIMER.  Returns true if it was pending, that is, armed
+   or expired but its callback not yet started.  A callback that
+   is already running is not waited for.  May be called from an
+   interrupt handler. */
+bool
+timer_del (struct kernel_timer *timer)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = alarm_cancel (&timer->alarm);
+
+  if (timer->expired)
+    {
+      /* Leave the semaphore's count alone; the timer thread
+         tolerates waking up to an empty list. */
+      list_remove (&timer->elem);
+      timer->expired = false;
+      was_pending = true;
+    }
+
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Returns true if TIMER is armed or its callback is waiting to
+   run. */
+bool
+timer_pending (const struct kernel_timer *timer)
+{
+  return timer->alarm.armed || timer->expired;
+}
+
+/* Alarm function for kernel timers: hands TIMER_ to the timer
+   thread. */
+static void
+kernel_timer_expire (void *timer_)
+{
+  struct kernel_timer *timer = timer_;
+
+  list_push_back (&expired_timers, &timer->elem);
+  timer->expired = true;
+  sema_up (&expired_sema);
+}
+
+/* Timer thread.  Runs the callbacks of expired kernel timers,
+   in expiry order, with interrupts on. */
+static void
+timer_thread (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      struct kernel_timer *timer = NULL;
+      enum intr_level old_level;
+
+      sema_down (&expired_sema);
+
+      old_level = intr_disable ();
+      if (!list_empty (&expired_timers))
+        {
+          timer = list_entry (list_pop_front (&expired_timers),
+                              struct kernel_timer, elem);
+          timer->expired = false;
+        }
+      intr_set_level (old_level);
+
+      if (timer != NULL)
+        timer->func (timer->aux);
+    }
+}
+
+/* Stores a snapshot of the timer interrupt cycle counts in
+   STATS. */
+void
+timer_get_cycle_stats (struct timer_cycle_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = cycle_stats;
+  intr_set_level (old_level);
+}
+
+/* Clears the timer interrupt cycle counts. */
+void
+timer_reset_cycle_stats (void)
+{
+  enum intr_level old_level = intr_disable ();
+  cycle_stats.cnt = 0;
+  cycle_stats.total = 0;
+  cycle_stats.max = 0;
+  intr_set_level (old_level);
+}
+
+/* Files ALARM in the wheel slot matching its expiry time.
+   Interrupts must be off. */
+static void
+wheel_insert (struct alarm *alarm)
+{
+  int64_t expires = alarm->expires;
+  int64_t delta = expires - wheel_time;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta < 0)
+    {
+      /* Already due: fire on the next tick processed. */
+      expires = wheel_time;
+      delta = 0;
+    }
+  else if (delta >= WHEEL_SPAN)
+    {
+      /* Too far out: park in the last level, to be re-filed
+         when that slot cascades. */
+      expires = wheel_time + WHEEL_SPAN - 1;
+      delta = WHEEL_SPAN - 1;
+    }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &alarm->elem);
+}
+
+/* Moves every alarm in LIST onto the end of DST, which must be
+   empty, leaving LIST empty. */
+static void
+move_all (struct list *dst, struct list *list)
+{
+  while (!list_empty (list))
+    list_push_back (dst, list_pop_front (list));
+}
+
+/* Re-files the alarms in the slot of LEVEL that covers
+   wheel_time into lower levels. */
+static void
+wheel_cascade (int level)
+{
+  int slot = (wheel_time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  struct list pending;
+
+  list_init (&pending);
+  move_all (&pending, &wheel[level][slot]);
+  while (!list_empty (&pending))
+    wheel_insert (list_entry (list_pop_front (&pending),
+                              struct alarm, elem));
+}
+
+/* Fires every alarm that expires at or before NOW.  Interrupts
+   must be off. */
+static void
+wheel_advance (int64_t now)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (wheel_time <= now)
+    {
+      struct list due;
+      int level;
+
+      /* Each time a level wraps around, pull the next slot of
+         the level above down into it. */
+      for (level = 1; level < WHEEL_LEVELS; level++)
+        {
+          if (((wheel_time >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) != 0)
+            break;
+          wheel_cascade (level);
+        }
+
+      /* Detach the slot and advance before firing, so that an
+         alarm function that re-arms for an expired time fires on
+         the next tick rather than looping here. */
+      list_init (&due);
+      move_all (&due, &wheel[0][wheel_time & WHEEL_MASK]);
+      wheel_time++;
+      while (!list_empty (&due))
+        {
+          struct alarm *alarm = list_entry (list_pop_front (&due),
+                                            struct alarm, elem);
+          alarm->armed = false;
+          alarm->func (alarm->aux);
+        }
+    }
+}
+
+/* Called by the idle thread, with interrupts off, just before
+   it halts.  If tickless idle is enabled and nothing needs the
+   next few ticks, replaces the periodic tick by a single
+   interrupt at the first tick that does: one with an alarm due
+   or a wheel cascade, a once-a-second MLFQS update, or at most
+   MAX_IDLE_TICKS ahead. */
+void
+timer_idle_enter (void)
+{
+  unsigned remaining;
+  int n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || idle_shot_ticks != 0 || wheel_time != ticks + 1
+      || !list_empty (&expired_timers))
+    return;
+
+  for (n = 1; n < MAX_IDLE_TICKS; n++)
+    {
+      int64_t t = ticks + n;
+      if (!list_empty (&wheel[0][t & WHEEL_MASK])
+          || (t & WHEEL_MASK) == 0
+          || (thread_mlfqs && t % TIMER_FREQ == 0))
+        break;
+    }
+  if (n <= 1)
+    return;
+
+  /* Keep the part of the current tick that has not yet elapsed,
+     so that the interrupt lands on a tick boundary. */
+  remaining = pit_read_count (0);
+  if (remaining == 0 || remaining > TICK_CYCLES)
+    remaining = TICK_CYCLES;
+  idle_shot_ticks = n;
+  idle_shot_first = remaining;
+  idle_shot_count = remaining + (n - 1) * TICK_CYCLES;
+  pit_start_one_shot (0, idle_shot_count);
+}
+
+/* Called with interrupts off when the CPU stops being idle.  If
+   the one-shot from timer_idle_enter() has not yet run out,
+   accounts for the whole ticks that have passed and restores
+   the periodic tick. */
+void
+timer_idle_exit (void)
+{
+  unsigned elapsed;
+  int passed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* If the count has run out, the interrupt is pending and
+     timer_interrupt() will catch up. */
+  if (idle_shot_ticks == 0 || pit_output_high (0))
+    return;
+
+  elapsed = idle_shot_count - pit_read_count (0);
+  passed = elapsed < idle_shot_first
+           ? 0 : 1 + (elapsed - idle_shot_first) / TICK_CYCLES;
+  if (passed >= idle_shot_ticks)
+    passed = idle_shot_ticks - 1;
+
+  idle_shot_ticks = 0;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+
+  /* No alarm is due in these ticks, so the wheel can catch up
+     on the next interrupt. */
+  ticks += passed;
+  thread_tick_idle (passed);
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  uint64_t start = rdtsc ();
+  uint64_t cycles;
+
+  /* Woken by a tickless idle one-shot: account for the ticks it
+     skipped and go back to periodic mode. */
+  if (idle_shot_ticks != 0)
+    {
+      int skipped = idle_shot_ticks - 1;
+
+      idle_shot_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      ticks += skipped;
+      thread_tick_idle (skipped);
+    }
+
   ticks++;
   thread_tick ();
   
-  /* check if thread sleep enough */
-  while(!list_empty(&alarm_list)){
-    struct thread *head = list_entry(list_front(&alarm_list),
-                                    struct thread, alarm_elem);
-    /* head is still sleeping */
-    if(head->wake_up_time > ticks){
-      break;
-    }
-    thread_unblock(head);
-    list_pop_front(&alarm_list); 
-  }
+  /* wake up threads that slept enough */
+  wheel_advance (ticks);
 
   /* advance scheduler part */
   if(thread_mlfqs){
@@ -218,6 +639,12 @@ timer_interrupt (struct intr_frame *args UNUSED)
       thread_update_priority_with_nice(thread_current());
     }
   }
+
+  cycles = rdtsc () - start;
+  cycle_stats.cnt++;
+  cycle_stats.total += cycles;
+  if (cycles > cycle_stats.max)
+    cycle_stats.max = cycles;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -1,18 +1,29 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, stop the periodic tick while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
+void timer_init_callbacks (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+/* Tickless idle, called by the idle thread and scheduler. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -26,4 +37,52 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* One-shot alarm kept on the timer wheel.  FUNC(AUX) is called
+   from the timer interrupt handler, with interrupts off, on the
+   first tick at or after EXPIRES. */
+typedef void alarm_func (void *aux);
+struct alarm
+  {
+    int64_t expires;            /* Tick at which to fire. */
+    alarm_func *func;           /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    bool armed;                 /* On the wheel? */
+  };
+
+void alarm_init (struct alarm *, alarm_func *, void *aux);
+void alarm_arm (struct alarm *, int64_t expires);
+bool alarm_cancel (struct alarm *);
+
+/* Kernel timer.  Like an alarm, but FUNC(AUX) is called later
+   from the "timerd" kernel thread instead of the interrupt
+   handler, so it may sleep, acquire locks, and allocate memory.
+   Callbacks run one at a time and should be short. */
+typedef void kernel_timer_func (void *aux);
+struct kernel_timer
+  {
+    struct alarm alarm;         /* Fires in interrupt context. */
+    kernel_timer_func *func;    /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    struct list_elem elem;      /* Element in expired timer list. */
+    bool expired;               /* On expired timer list? */
+  };
+
+void timer_setup (struct kernel_timer *, kernel_timer_func *, void *aux);
+void timer_add (struct kernel_timer *, int64_t expires);
+bool timer_mod (struct kernel_timer *, int64_t expires);
+bool timer_del (struct kernel_timer *);
+bool timer_pending (const struct kernel_timer *);
+
+/* Cycles spent in the timer interrupt handler. */
+struct timer_cycle_stats
+  {
+    int64_t cnt;                /* # of interrupts measured. */
+    uint64_t total;             /* Sum of cycles over all of them. */
+    uint64_t max;               /* Most cycles spent in one. */
+  };
+
+void timer_get_cycle_stats (struct timer_cycle_stats *);
+void timer_reset_cycle_stats (void);
+
 #endif /* devices/timer.h */
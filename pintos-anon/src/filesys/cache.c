@@ -0,0 +1,582 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* The code in this file caches sectors of the file system
+   device in memory.  Every access to file system sectors goes
+   through the cache, so that it always holds the latest data for
+   the sectors it contains.  Writes only modify the cache.
+   Modified sectors are written back when they are evicted,
+   every FLUSH_INTERVAL ticks by a flusher thread, and when the
+   file system shuts down.
+
+   Entries are found by sector through a hash table and evicted
+   in clock order.  A global lock protects the index and each
+   entry's identity and pin count; each entry's contents are
+   protected by its own reader-writer lock, so that threads
+   working on different sectors, or only reading the same one,
+   do not wait for each other.  A thread pins an entry while it
+   holds the entry's lock, and pinned entries are never
+   evicted.
+
+   Sectors that readers are expected to need soon may be queued
+   for read-ahead.  A kernel thread claims entries for a batch
+   of queued sectors and submits all of their reads at once,
+   letting the I/O scheduler merge them, while the readers go
+   on with the data they already have. */
+
+/* Sectors per page of cache memory. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Timer ticks between writes of dirty sectors to disk. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* Maximum number of sectors waiting for read-ahead. */
+#define READ_AHEAD_QUEUE 64
+
+/* Maximum number of sectors read ahead at once. */
+#define READ_AHEAD_BATCH 16
+
+/* A cached sector. */
+struct cache_entry
+  {
+    /* Protected by cache_lock. */
+    struct hash_elem hash_elem;         /* Element in cache_index. */
+    block_sector_t sector;              /* Sector held, if IN_USE. */
+    bool in_use;                        /* Holds a sector? */
+    bool accessed;                      /* Used since the clock hand passed? */
+    int pin_cnt;                        /* Threads using this entry. */
+    bool read_ahead;                    /* Read ahead and not yet used? */
+
+    /* Protected by LOCK. */
+    struct rwlock lock;                 /* Protects the members below. */
+    bool dirty;                         /* Changed since last written? */
+    enum block_io_class class;          /* What the sector holds. */
+    uint8_t *data;                      /* BLOCK_SECTOR_SIZE bytes. */
+  };
+
+/* Number of sectors in the buffer cache. */
+size_t cache_size = CACHE_DEFAULT_SIZE;
+
+static struct cache_entry *entries;     /* CACHE_SIZE entries. */
+static struct hash cache_index;         /* In-use entries by sector. */
+static struct lock cache_lock;          /* Protects index and pins. */
+static struct condition unpinned;       /* Signaled when pin_cnt drops. */
+static size_t clock_hand;               /* Next entry to consider. */
+
+/* Write-back of all dirty sectors, protected by flush_lock. */
+static struct lock flush_lock;
+static struct cache_entry **flush_list; /* Entries being written. */
+static struct block_request *flush_requests; /* Their requests. */
+
+/* A sector waiting to be read ahead. */
+struct read_ahead 
+  {
+    block_sector_t sector;              /* Sector to read. */
+    enum block_io_class class;          /* What the sector holds. */
+  };
+
+/* Read-ahead queue, protected by cache_lock. */
+static struct read_ahead ra_queue[READ_AHEAD_QUEUE];
+static size_t ra_head;                  /* Index of oldest sector. */
+static size_t ra_cnt;                   /* Number of queued sectors. */
+static size_t ra_batch;                 /* Sectors to read ahead at once. */
+static struct condition ra_pending;     /* Signaled when RA_CNT rises. */
+
+/* Statistics, protected by cache_lock. */
+static unsigned long long hit_cnt;      /* Lookups found in cache. */
+static unsigned long long miss_cnt;     /* Lookups that loaded a sector. */
+static unsigned long long write_back_cnt; /* Sectors written back. */
+static unsigned long long read_ahead_cnt; /* Sectors read ahead. */
+static unsigned long long read_ahead_hit_cnt; /* ...later looked up. */
+
+static hash_hash_func entry_hash;
+static hash_less_func entry_less;
+static thread_func read_ahead_thread;
+static thread_func flusher_thread;
+static int compare_sectors (const void *, const void *);
+
+/* Initializes the buffer cache with cache_size entries. */
+void
+cache_init (void) 
+{
+  uint8_t *page = NULL;
+  size_t i;
+
+  if (cache_size == 0)
+    PANIC ("buffer cache must have at least one sector");
+
+  entries = calloc (cache_size, sizeof *entries);
+  flush_list = malloc (cache_size * sizeof *flush_list);
+  flush_requests = malloc (cache_size * sizeof *flush_requests);
+  if (entries == NULL || flush_list == NULL || flush_requests == NULL
+      || !hash_init (&cache_index, entry_hash, entry_less, NULL))
+    PANIC ("buffer cache: out of memory");
+  for (i = 0; i < cache_size; i++) 
+    {
+      struct cache_entry *e = &entries[i];
+
+      if (i % PAGE_SECTORS == 0) 
+        {
+          page = palloc_get_page (0);
+          if (page == NULL)
+            PANIC ("buffer cache: out of memory");
+        }
+      e->in_use = false;
+      rwlock_init (&e->lock);
+      e->dirty = false;
+      e->data = page + (i % PAGE_SECTORS) * BLOCK_SECTOR_SIZE;
+    }
+  lock_init (&cache_lock);
+  lock_set_name (&cache_lock, "cache_lock");
+  cond_init (&unpinned);
+  lock_init (&flush_lock);
+  thread_create ("flusher", PRI_DEFAULT, flusher_thread, NULL);
+
+  /* Leave at least half of the cache for sectors being used. */
+  ra_batch = cache_size / 2 < READ_AHEAD_BATCH ? cache_size / 2
+                                               : READ_AHEAD_BATCH;
+  cond_init (&ra_pending);
+  if (ra_batch > 0)
+    thread_create ("read-ahead", PRI_DEFAULT, read_ahead_thread, NULL);
+}
+
+/* Returns the in-use entry for SECTOR, or a null pointer if
+   SECTOR is not cached.  Must be called with cache_lock held. */
+static struct cache_entry *
+lookup (block_sector_t sector) 
+{
+  struct cache_entry key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&cache_index, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct cache_entry, hash_elem) : NULL;
+}
+
+/* Advances the clock hand to an entry that may be replaced: one
+   not in use, or else one that is unpinned and has not been
+   accessed since the hand last passed it.  Returns a null
+   pointer if every entry is pinned.  Must be called with
+   cache_lock held. */
+static struct cache_entry *
+find_victim (void) 
+{
+  size_t i;
+
+  for (i = 0; i < 2 * cache_size; i++) 
+    {
+      struct cache_entry *e = &entries[clock_hand];
+      clock_hand = (clock_hand + 1) % cache_size;
+
+      if (!e->in_use)
+        return e;
+      else if (e->pin_cnt > 0)
+        continue;
+      else if (e->accessed)
+        e->accessed = false;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Writes E's data back to disk.  The caller must hold E's lock
+   and have E pinned. */
+static void
+write_back (struct cache_entry *e) 
+{
+  block_write_multi (fs_device, e->sector, 1, e->data, e->class);
+  e->dirty = false;
+}
+
+/* Drops a pin on E.  Must be called with cache_lock held. */
+static void
+unpin (struct cache_entry *e) 
+{
+  ASSERT (e->pin_cnt > 0);
+  if (--e->pin_cnt == 0)
+    cond_signal (&unpinned, &cache_lock);
+}
+
+/* Returns the entry for SECTOR, pinned.  If SECTOR is cached,
+   sets *HIT to true and returns its entry without taking its
+   lock.  Otherwise, replaces another entry with SECTOR, sets
+   *HIT to false, and returns the new entry with its lock held
+   for writing and its contents not yet read.  If every entry is
+   pinned, waits for one to be unpinned if WAIT is true, or
+   returns a null pointer if WAIT is false.  Must be called with
+   cache_lock held, which it may release and reacquire. */
+static struct cache_entry *
+find_or_claim (block_sector_t sector, bool wait, bool *hit) 
+{
+  struct cache_entry *e;
+
+  for (;;) 
+    {
+      e = lookup (sector);
+      if (e != NULL) 
+        {
+          e->pin_cnt++;
+          e->accessed = true;
+          *hit = true;
+          return e;
+        }
+
+      e = find_victim ();
+      if (e == NULL) 
+        {
+          if (!wait)
+            return NULL;
+          cond_wait (&unpinned, &cache_lock);
+        }
+      else if (e->in_use && e->dirty) 
+        {
+          /* Write the victim back while it is still in the
+             index, so that no one can read a stale copy of its
+             sector from disk meanwhile, then look again. */
+          bool written = false;
+
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          rwlock_acquire_read (&e->lock);
+          if (e->dirty) 
+            {
+              write_back (e);
+              written = true;
+            }
+          rwlock_release_read (&e->lock);
+          lock_acquire (&cache_lock);
+          if (written)
+            write_back_cnt++;
+          unpin (e);
+        }
+      else
+        break;
+    }
+
+  /* Take over the clean, unpinned victim.  No one holds its lock,
+     since only pinned entries are locked. */
+  if (e->in_use)
+    hash_delete (&cache_index, &e->hash_elem);
+  e->sector = sector;
+  e->in_use = true;
+  e->accessed = true;
+  e->read_ahead = false;
+  e->pin_cnt = 1;
+  hash_insert (&cache_index, &e->hash_elem);
+  rwlock_acquire_write (&e->lock);
+  *hit = false;
+  return e;
+}
+
+/* Returns the entry for SECTOR, pinned and with its lock held
+   for writing if WRITE is true, for reading otherwise.  If
+   SECTOR is not cached, replaces another entry with it, reading
+   its contents from disk as CLASS if NEED_READ is true; if
+   NEED_READ is false, the caller must hold the lock for writing
+   and overwrite the whole sector. */
+static struct cache_entry *
+acquire_entry (block_sector_t sector, enum block_io_class class,
+               bool need_read, bool write) 
+{
+  struct cache_entry *e;
+  bool hit;
+
+  ASSERT (need_read || write);
+
+  lock_acquire (&cache_lock);
+  e = find_or_claim (sector, true, &hit);
+  if (hit) 
+    {
+      hit_cnt++;
+      if (e->read_ahead) 
+        {
+          e->read_ahead = false;
+          read_ahead_hit_cnt++;
+        }
+      lock_release (&cache_lock);
+
+      if (write)
+        rwlock_acquire_write (&e->lock);
+      else
+        rwlock_acquire_read (&e->lock);
+      return e;
+    }
+  miss_cnt++;
+  lock_release (&cache_lock);
+
+  e->class = class;
+  if (need_read)
+    block_read_multi (fs_device, sector, 1, e->data, class);
+  if (!write)
+    rwlock_downgrade (&e->lock);
+  return e;
+}
+
+/* Releases E's lock, held for writing if WRITE is true, and
+   unpins it. */
+static void
+release_entry (struct cache_entry *e, bool write) 
+{
+  if (write)
+    rwlock_release_write (&e->lock);
+  else
+    rwlock_release_read (&e->lock);
+
+  lock_acquire (&cache_lock);
+  unpin (e);
+  lock_release (&cache_lock);
+}
+
+/* Copies SIZE bytes starting at offset OFS in SECTOR of the file
+   system device into BUFFER, reading the sector into the cache
+   as CLASS if necessary. */
+void
+cache_read_at (block_sector_t sector, enum block_io_class class,
+               void *buffer, off_t ofs, size_t size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = acquire_entry (sector, class, true, false);
+  memcpy (buffer, e->data + ofs, size);
+  release_entry (e, false);
+}
+
+/* Copies SIZE bytes from BUFFER into offset OFS in SECTOR of the
+   file system device, as CLASS.  The sector is written back to
+   disk later. */
+void
+cache_write_at (block_sector_t sector, enum block_io_class class,
+                const void *buffer, off_t ofs, size_t size) 
+{
+  bool whole = ofs == 0 && size == BLOCK_SECTOR_SIZE;
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = acquire_entry (sector, class, !whole, true);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  e->class = class;
+  release_entry (e, true);
+}
+
+/* Queues SECTOR, which holds data of the given CLASS, to be read
+   into the cache in the background.  Does nothing if SECTOR is
+   already cached or queued, or if the queue is full. */
+void
+cache_read_ahead (block_sector_t sector, enum block_io_class class) 
+{
+  size_t i;
+
+  if (ra_batch == 0)
+    return;
+
+  lock_acquire (&cache_lock);
+  if (ra_cnt >= READ_AHEAD_QUEUE || lookup (sector) != NULL)
+    goto done;
+  for (i = 0; i < ra_cnt; i++)
+    if (ra_queue[(ra_head + i) % READ_AHEAD_QUEUE].sector == sector)
+      goto done;
+
+  i = (ra_head + ra_cnt++) % READ_AHEAD_QUEUE;
+  ra_queue[i].sector = sector;
+  ra_queue[i].class = class;
+  cond_signal (&ra_pending, &cache_lock);
+
+ done:
+  lock_release (&cache_lock);
+}
+
+/* Reads queued sectors into the cache, up to RA_BATCH at a
+   time.  Each batch is submitted as a whole before waiting for
+   any of it. */
+static void
+read_ahead_thread (void *aux UNUSED) 
+{
+  static struct block_request requests[READ_AHEAD_BATCH];
+  static struct cache_entry *batch[READ_AHEAD_BATCH];
+
+  for (;;) 
+    {
+      size_t cnt = 0;
+      size_t i;
+
+      /* Claim entries for as many queued sectors as fit in a
+         batch.  Sectors that got cached meanwhile are skipped.
+         If every entry is pinned, the rest of the queue is
+         dropped, since readers need the entries more. */
+      lock_acquire (&cache_lock);
+      while (ra_cnt == 0)
+        cond_wait (&ra_pending, &cache_lock);
+      while (ra_cnt > 0 && cnt < ra_batch) 
+        {
+          /* Copy the slot out before freeing it, because
+             find_or_claim() may drop cache_lock to write back a
+             victim, letting cache_read_ahead() reuse the slot. */
+          struct read_ahead ra = ra_queue[ra_head];
+          struct cache_entry *e;
+          bool hit;
+
+          ra_head = (ra_head + 1) % READ_AHEAD_QUEUE;
+          ra_cnt--;
+
+          e = find_or_claim (ra.sector, false, &hit);
+          if (e == NULL) 
+            {
+              ra_cnt = 0;
+              break;
+            }
+          else if (hit)
+            unpin (e);
+          else 
+            {
+              e->class = ra.class;
+              e->read_ahead = true;
+              read_ahead_cnt++;
+              batch[cnt++] = e;
+            }
+        }
+      lock_release (&cache_lock);
+
+      /* Read the batch.  Readers that look up these sectors in
+         the meantime wait on the entries' locks. */
+      for (i = 0; i < cnt; i++) 
+        {
+          block_request_init (&requests[i], false, batch[i]->sector, 1,
+                              batch[i]->data, batch[i]->class, NULL, NULL);
+          block_submit (fs_device, &requests[i]);
+        }
+      for (i = 0; i < cnt; i++) 
+        {
+          block_wait (&requests[i]);
+          release_entry (batch[i], true);
+        }
+    }
+}
+
+/* Writes every modified sector in the cache back to disk, in
+   order of sector number.  All of the writes are submitted
+   before waiting for any of them, so that the I/O scheduler can
+   merge neighbors. */
+void
+cache_flush (void) 
+{
+  size_t cnt = 0;
+  size_t i;
+
+  lock_acquire (&flush_lock);
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cache_size; i++) 
+    {
+      struct cache_entry *e = &entries[i];
+      if (e->in_use && e->dirty) 
+        {
+          e->pin_cnt++;
+          flush_list[cnt++] = e;
+        }
+    }
+  lock_release (&cache_lock);
+
+  qsort (flush_list, cnt, sizeof *flush_list, compare_sectors);
+  for (i = 0; i < cnt; i++) 
+    {
+      struct cache_entry *e = flush_list[i];
+
+      rwlock_acquire_read (&e->lock);
+      if (e->dirty) 
+        {
+          block_request_init (&flush_requests[i], true, e->sector, 1,
+                              e->data, e->class, NULL, NULL);
+          block_submit (fs_device, &flush_requests[i]);
+        }
+    }
+  for (i = 0; i < cnt; i++) 
+    {
+      struct cache_entry *e = flush_list[i];
+      bool written = e->dirty;
+
+      if (written) 
+        {
+          block_wait (&flush_requests[i]);
+          e->dirty = false;
+        }
+      rwlock_release_read (&e->lock);
+
+      lock_acquire (&cache_lock);
+      if (written)
+        write_back_cnt++;
+      unpin (e);
+      lock_release (&cache_lock);
+    }
+
+  lock_release (&flush_lock);
+}
+
+/* Writes dirty sectors back to disk every FLUSH_INTERVAL timer
+   ticks, so that they do not stay only in memory for long. */
+static void
+flusher_thread (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      cache_flush ();
+    }
+}
+
+/* Orders pointers to cache entries by sector. */
+static int
+compare_sectors (const void *a_, const void *b_) 
+{
+  const struct cache_entry *a = *(struct cache_entry *const *) a_;
+  const struct cache_entry *b = *(struct cache_entry *const *) b_;
+  return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void) 
+{
+  unsigned long long lookups = hit_cnt + miss_cnt;
+  unsigned long long permille = lookups > 0 ? hit_cnt * 1000 / lookups : 0;
+
+  if (entries == NULL)
+    return;
+  printf ("Buffer cache: %zu sectors, %llu hits, %llu misses "
+          "(%llu.%llu%% hit rate), %llu write-backs\n",
+          cache_size, hit_cnt, miss_cnt, permille / 10, permille % 10,
+          write_back_cnt);
+  printf ("Read-ahead: %llu sectors, %llu used\n",
+          read_ahead_cnt, read_ahead_hit_cnt);
+}
+
+/* Returns a hash of E's sector. */
+static unsigned
+entry_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_int (hash_entry (e, struct cache_entry, hash_elem)->sector);
+}
+
+/* Orders entries by sector. */
+static bool
+entry_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED) 
+{
+  return (hash_entry (a, struct cache_entry, hash_elem)->sector
+          < hash_entry (b, struct cache_entry, hash_elem)->sector);
+}
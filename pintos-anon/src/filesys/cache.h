@@ -0,0 +1,24 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Default number of sectors in the buffer cache. */
+#define CACHE_DEFAULT_SIZE 64
+
+/* Number of sectors in the buffer cache.  May be changed before
+   cache_init(). */
+extern size_t cache_size;
+
+void cache_init (void);
+void cache_read_at (block_sector_t, enum block_io_class,
+                    void *buffer, off_t ofs, size_t size);
+void cache_write_at (block_sector_t, enum block_io_class,
+                     const void *buffer, off_t ofs, size_t size);
+void cache_read_ahead (block_sector_t, enum block_io_class);
+void cache_flush (void);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
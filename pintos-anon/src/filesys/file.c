@@ -1,7 +1,12 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* Smallest and largest read-ahead windows, in sectors. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 32
 
 /* An open file. */
 struct file 
@@ -9,26 +14,46 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+
+    /* Sequential access detection. */
+    off_t ra_next;              /* Offset that would continue the last read. */
+    off_t ra_end;               /* End of the bytes already read ahead. */
+    int ra_window;              /* Sectors to keep read ahead, 0 if random. */
   };
 
+/* Cache of open files. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), 0, NULL);
+  if (file_cache == NULL)
+    PANIC ("file_init: out of memory");
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
@@ -49,7 +74,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (file_cache, file); 
     }
 }
 
@@ -60,6 +85,45 @@ file_get_inode (struct file *file)
   return file->inode;
 }
 
+/* Notes that SIZE bytes were just read from FILE at OFFSET.  A
+   read that starts where the previous one ended doubles FILE's
+   read-ahead window, up to READ_AHEAD_MAX sectors, and the
+   window's worth of data past OFFSET + SIZE is read ahead.  Any
+   other read closes the window. */
+static void
+read_ahead (struct file *file, off_t size, off_t offset) 
+{
+  off_t end = offset + size;
+
+  if (size <= 0)
+    return;
+
+  if (offset == file->ra_next) 
+    {
+      off_t limit;
+
+      if (file->ra_window == 0)
+        file->ra_window = READ_AHEAD_MIN;
+      else if (file->ra_window < READ_AHEAD_MAX)
+        file->ra_window *= 2;
+
+      limit = end + file->ra_window * BLOCK_SECTOR_SIZE;
+      if (file->ra_end < end)
+        file->ra_end = end;
+      if (file->ra_end < limit) 
+        {
+          inode_read_ahead (file->inode, limit - file->ra_end, file->ra_end);
+          file->ra_end = limit;
+        }
+    }
+  else 
+    {
+      file->ra_window = 0;
+      file->ra_end = end;
+    }
+  file->ra_next = end;
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
@@ -69,6 +133,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  read_ahead (file, bytes_read, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,15 +146,16 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  read_ahead (file, bytes_read, file_ofs);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file extends the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +168,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file extends the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
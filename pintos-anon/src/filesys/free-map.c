@@ -4,9 +4,11 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct rwlock free_map_lock;  /* Protects free_map and its file. */
 
 /* Initializes the free map. */
 void
@@ -17,6 +19,7 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  rwlock_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,7 +30,10 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  block_sector_t sector;
+
+  rwlock_acquire_write (&free_map_lock);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
@@ -37,16 +43,93 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
     }
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
+  rwlock_release_write (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
+/* Finds a run of up to WANT free sectors for
+   free_map_allocate_run(), as described there, and stores its
+   first sector into *SECTORP.  Returns the run's length, or 0 if
+   the disk is full.  FREE_MAP_LOCK must be held for reading or
+   writing. */
+static size_t
+find_run (size_t want, block_sector_t goal, block_sector_t *sectorp) 
+{
+  size_t size = bitmap_size (free_map);
+  size_t cnt = 0;
+
+  if (goal != 0 && goal < size && !bitmap_test (free_map, goal))
+    {
+      *sectorp = goal;
+      while (cnt < want && goal + cnt < size
+             && !bitmap_test (free_map, goal + cnt))
+        cnt++;
+    }
+  else
+    for (cnt = want; cnt > 0; cnt /= 2)
+      {
+        *sectorp = bitmap_scan (free_map, 0, cnt, false);
+        if (*sectorp != BITMAP_ERROR)
+          break;
+      }
+  return cnt;
+}
+
+/* Allocates a run of up to WANT consecutive sectors from the
+   free map and stores the first into *SECTORP.  If GOAL is
+   nonzero and free, the run starts there, so that a file can
+   grow in place.  Otherwise, the run is the first free one of
+   WANT sectors, or failing that, of the largest power-of-2
+   fraction of WANT sectors that fits anywhere.
+   Returns the number of sectors allocated, or 0 if the disk is
+   full or the free_map file could not be written. */
+size_t
+free_map_allocate_run (size_t want, block_sector_t goal,
+                       block_sector_t *sectorp)
+{
+  block_sector_t sector = BITMAP_ERROR;
+  size_t cnt;
+
+  ASSERT (want > 0);
+
+  /* Search the free map for reading, so that allocators share it
+     while they search.  If the upgrade fails because another
+     thread also holds the free map or awaits it for writing, the
+     run found may be taken by the time we get it, so search again
+     for writing. */
+  rwlock_acquire_read (&free_map_lock);
+  cnt = find_run (want, goal, &sector);
+  if (!rwlock_try_upgrade (&free_map_lock)) 
+    {
+      rwlock_release_read (&free_map_lock);
+      rwlock_acquire_write (&free_map_lock);
+      cnt = find_run (want, goal, &sector);
+    }
+
+  if (cnt > 0)
+    {
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      if (free_map_file != NULL && !bitmap_write (free_map, free_map_file))
+        {
+          bitmap_set_multiple (free_map, sector, cnt, false);
+          cnt = 0;
+        }
+      else
+        *sectorp = sector;
+    }
+  rwlock_release_write (&free_map_lock);
+  return cnt;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  rwlock_acquire_write (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
+  rwlock_release_write (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -4,9 +4,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ustar.h>
+#include "filesys/cache.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/cpu.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -221,3 +224,127 @@ fsutil_append (char **argv)
   file_close (src);
   free (buffer);
 }
+
+/* Prints I/O statistics for every block device. */
+void
+fsutil_iostat (char **argv UNUSED) 
+{
+  struct block *block;
+
+  printf ("Block device I/O statistics:\n");
+  for (block = block_first (); block != NULL; block = block_next (block))
+    block_print_device_stats (block);
+  printf ("End of statistics.\n");
+}
+
+/* Prints the extents of each file in the root directory, and
+   totals, to show how fragmented the file system is. */
+void
+fsutil_frag (char **argv UNUSED) 
+{
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+  size_t file_cnt = 0;
+  size_t total_sectors = 0;
+  size_t total_extents = 0;
+
+  printf ("Extents of files in the root directory:\n");
+  dir = dir_open_root ();
+  if (dir == NULL)
+    PANIC ("root dir open failed");
+  while (dir_readdir (dir, name)) 
+    {
+      struct file *file = filesys_open (name);
+      struct inode *inode;
+      size_t extent_cnt;
+      size_t i;
+
+      if (file == NULL)
+        PANIC ("%s: open failed", name);
+      inode = file_get_inode (file);
+      extent_cnt = inode_extent_cnt (inode);
+      printf ("%s: %"PROTd" bytes in %zu extents:",
+              name, inode_length (inode), extent_cnt);
+      for (i = 0; i < extent_cnt; i++) 
+        {
+          block_sector_t start;
+          size_t cnt;
+
+          inode_get_extent (inode, i, &start, &cnt);
+          printf (" %"PRDSNu"+%zu", start, cnt);
+          total_sectors += cnt;
+        }
+      printf ("\n");
+      file_close (file);
+
+      file_cnt++;
+      total_extents += extent_cnt;
+    }
+  dir_close (dir);
+  printf ("%zu files, %zu sectors in %zu extents.\n",
+          file_cnt, total_sectors, total_extents);
+}
+
+/* Size of each file written by fsutil_fsbench(). */
+#define BENCH_SIZE (384 * 1024)
+
+/* Writes two files a page at a time, alternating between them
+   as two programs writing at once would, then reads each of
+   them back sequentially and prints its extents and read
+   speed.  Run with -alloc=sector to compare with allocating one
+   sector at a time. */
+void
+fsutil_fsbench (char **argv UNUSED) 
+{
+  static const char *names[2] = {"bench-a", "bench-b"};
+  struct file *files[2];
+  void *buffer;
+  off_t ofs;
+  int i;
+
+  printf ("Benchmarking sequential reads with %s allocation...\n",
+          inode_extent_alloc ? "extent" : "sector");
+  buffer = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
+  /* Write the files at the same time, then make sure that
+     they are on disk. */
+  for (i = 0; i < 2; i++) 
+    {
+      if (!filesys_create (names[i], 0))
+        PANIC ("%s: create failed", names[i]);
+      files[i] = filesys_open (names[i]);
+      if (files[i] == NULL)
+        PANIC ("%s: open failed", names[i]);
+    }
+  for (ofs = 0; ofs < BENCH_SIZE; ofs += PGSIZE)
+    for (i = 0; i < 2; i++)
+      if (file_write (files[i], buffer, PGSIZE) != PGSIZE)
+        PANIC ("%s: write failed at offset %"PROTd, names[i], ofs);
+  for (i = 0; i < 2; i++)
+    file_close (files[i]);
+  cache_flush ();
+
+  /* Read them back.  Each file is larger than the buffer cache,
+     so its first sectors are no longer cached. */
+  for (i = 0; i < 2; i++) 
+    {
+      struct file *file = filesys_open (names[i]);
+      uint64_t start, cycles;
+
+      if (file == NULL)
+        PANIC ("%s: open failed", names[i]);
+      start = rdtsc ();
+      while (file_read (file, buffer, PGSIZE) == PGSIZE)
+        continue;
+      cycles = rdtsc () - start;
+      printf ("%s: %zu extents, read %d kB in %llu cycles "
+              "(%llu cycles/kB)\n",
+              names[i], inode_extent_cnt (file_get_inode (file)),
+              BENCH_SIZE / 1024, cycles, cycles / (BENCH_SIZE / 1024));
+      file_close (file);
+      if (!filesys_remove (names[i]))
+        PANIC ("%s: delete failed", names[i]);
+    }
+
+  palloc_free_page (buffer);
+}
@@ -3,23 +3,77 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of extents stored in the inode itself. */
+#define INLINE_EXTENTS 56
+
+/* Number of extents in an extent block. */
+#define EXTENTS_PER_BLOCK (BLOCK_SECTOR_SIZE / sizeof (struct extent))
+
+/* Number of extent blocks that the inode points to directly. */
+#define DIRECT_BLOCK_CNT 11
+
+/* Number of extent blocks that the indirect block points to. */
+#define INDIRECT_BLOCK_CNT (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Number of extent blocks an inode may have. */
+#define EXTENT_BLOCK_CNT (DIRECT_BLOCK_CNT + INDIRECT_BLOCK_CNT)
+
+/* Maximum number of extents in a file, 8,952.  Each extent but
+   the last is followed by at least one sector that is not in the
+   file, or it would have been merged with the next, so a file
+   has at most half as many extents as the disk has sectors.
+   Thus even a file allocated one sector at a time can fill the
+   8 MB (16,384-sector) file system partitions that Pintos
+   supports. */
+#define MAX_EXTENTS (INLINE_EXTENTS + EXTENT_BLOCK_CNT * EXTENTS_PER_BLOCK)
+
+/* Most sectors to preallocate past the end of a growing file. */
+#define PREALLOC_MAX 64
+
+/* A run of consecutive sectors. */
+struct extent
+  {
+    block_sector_t start;               /* First sector. */
+    uint32_t cnt;                       /* Number of sectors. */
+  };
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   A file's data occupies its extents in order: the first
+   INLINE_EXTENTS are stored here, the rest in extent blocks.
+   The first DIRECT_BLOCK_CNT extent blocks are listed here, the
+   rest in an indirect block.  The extents may hold more sectors
+   than LENGTH needs, for sectors preallocated while the file
+   grows. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t extent_cnt;                /* Number of extents. */
+    uint32_t sector_cnt;                /* Sectors in all extents. */
+    struct extent extents[INLINE_EXTENTS];  /* First extents. */
+    block_sector_t extent_blocks[DIRECT_BLOCK_CNT]; /* Further extents. */
+    block_sector_t indirect_block;      /* Yet more extent blocks. */
   };
 
+/* Allocate file data a whole run at a time, with preallocation?
+   If false, data sectors are allocated one at a time from the
+   start of the disk, which is useful for comparison.  Set by
+   the kernel command-line option "-alloc=sector". */
+bool inode_extent_alloc = true;
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -36,32 +90,387 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct lock grow_lock;              /* Serializes file growth. */
     struct inode_disk data;             /* Inode content. */
+    block_sector_t *indirect_block;     /* Loaded indirect block. */
+    struct extent **extent_blocks;      /* Loaded extent blocks, or null. */
+    size_t hint_extent;                 /* Extent found by last lookup. */
+    size_t hint_first;                  /* Its first sector in the file. */
   };
 
+/* Returns the I/O class under which to account for transfers of
+   data belonging to the inode in INODE_SECTOR. */
+static enum block_io_class
+data_class (block_sector_t inode_sector) 
+{
+  return inode_sector == FREE_MAP_SECTOR ? BLOCK_IO_FREE_MAP : BLOCK_IO_DATA;
+}
+
+/* Returns extent IDX of INODE. */
+static struct extent *
+get_extent (const struct inode *inode, size_t idx)
+{
+  ASSERT (idx < MAX_EXTENTS);
+  if (idx < INLINE_EXTENTS)
+    return (struct extent *) &inode->data.extents[idx];
+  idx -= INLINE_EXTENTS;
+  return &inode->extent_blocks[idx / EXTENTS_PER_BLOCK][idx % EXTENTS_PER_BLOCK];
+}
+
+/* Returns the number of extent blocks that hold EXTENT_CNT
+   extents. */
+static size_t
+extent_block_cnt (size_t extent_cnt) 
+{
+  return (extent_cnt > INLINE_EXTENTS
+          ? DIV_ROUND_UP (extent_cnt - INLINE_EXTENTS, EXTENTS_PER_BLOCK)
+          : 0);
+}
+
+/* Returns a pointer to the sector number of INODE's extent block
+   B, in the inode or in its indirect block. */
+static block_sector_t *
+extent_block_sector (struct inode *inode, size_t b) 
+{
+  ASSERT (b < EXTENT_BLOCK_CNT);
+  if (b < DIRECT_BLOCK_CNT)
+    return &inode->data.extent_blocks[b];
+  return &inode->indirect_block[b - DIRECT_BLOCK_CNT];
+}
+
+/* Writes extent IDX of INODE to its extent block on disk.
+   Extents stored in the inode itself are written along with the
+   inode. */
+static void
+save_extent (struct inode *inode, size_t idx)
+{
+  if (idx >= INLINE_EXTENTS)
+    {
+      size_t ofs = (idx - INLINE_EXTENTS) % EXTENTS_PER_BLOCK;
+      block_sector_t block = *extent_block_sector (
+        inode, (idx - INLINE_EXTENTS) / EXTENTS_PER_BLOCK);
+      cache_write_at (block, BLOCK_IO_INODE, get_extent (inode, idx),
+                      ofs * sizeof (struct extent), sizeof (struct extent));
+    }
+}
+
+/* Writes INODE's on-disk inode back to disk. */
+static void
+save_inode (struct inode *inode)
+{
+  cache_write_at (inode->sector, BLOCK_IO_INODE, &inode->data,
+                  0, BLOCK_SECTOR_SIZE);
+}
+
+/* Returns the sector that holds data sector IDX of INODE, or -1
+   if INODE has no such sector.  The walk over INODE's extents,
+   all of which are in memory, starts from the extent that the
+   last lookup found if that is not past IDX, so that sequential
+   access costs constant time per sector.  Readers look up
+   sectors without locking, so the two halves of the hint are
+   read and written with interrupts off. */
+static block_sector_t
+index_to_sector (struct inode *inode, size_t idx)
+{
+  enum intr_level old_level;
+  size_t i, first;
+
+  old_level = intr_disable ();
+  i = inode->hint_extent;
+  first = inode->hint_first;
+  intr_set_level (old_level);
+  if (i >= inode->data.extent_cnt || first > idx)
+    i = first = 0;
+
+  for (; i < inode->data.extent_cnt; i++)
+    {
+      const struct extent *e = get_extent (inode, i);
+      if (idx - first < e->cnt)
+        {
+          old_level = intr_disable ();
+          inode->hint_extent = i;
+          inode->hint_first = first;
+          intr_set_level (old_level);
+          return e->start + (idx - first);
+        }
+      first += e->cnt;
+    }
+  return -1;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos)
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return index_to_sector (inode, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
 
+/* Frees INODE's indirect block. */
+static void
+release_indirect_block (struct inode *inode) 
+{
+  free_map_release (inode->data.indirect_block, 1);
+  inode->data.indirect_block = 0;
+  free (inode->indirect_block);
+  inode->indirect_block = NULL;
+}
+
+/* Frees INODE's loaded extent blocks and indirect block, and the
+   table of extent blocks itself. */
+static void
+free_extent_blocks (struct inode *inode) 
+{
+  size_t b;
+
+  if (inode->extent_blocks != NULL) 
+    {
+      for (b = 0; b < EXTENT_BLOCK_CNT; b++)
+        free (inode->extent_blocks[b]);
+      free (inode->extent_blocks);
+      inode->extent_blocks = NULL;
+    }
+  free (inode->indirect_block);
+  inode->indirect_block = NULL;
+}
+
+/* Allocates the table of INODE's extent blocks, unless it
+   already has one.  The table is never moved, because readers
+   look up extents without locking, so it is made large enough
+   for every extent block at once.  Most files never need it.
+   Returns false if memory allocation fails. */
+static bool
+allocate_extent_table (struct inode *inode) 
+{
+  if (inode->extent_blocks == NULL)
+    inode->extent_blocks = calloc (EXTENT_BLOCK_CNT,
+                                   sizeof *inode->extent_blocks);
+  return inode->extent_blocks != NULL;
+}
+
+/* Allocates extent block B for INODE, along with the indirect
+   block if B is the first extent block listed there.  Returns
+   false if memory or disk allocation fails. */
+static bool
+allocate_extent_block (struct inode *inode, size_t b) 
+{
+  struct extent *block;
+  block_sector_t *sectorp;
+
+  if (!allocate_extent_table (inode))
+    return false;
+  if (b == DIRECT_BLOCK_CNT) 
+    {
+      inode->indirect_block = malloc (BLOCK_SECTOR_SIZE);
+      if (inode->indirect_block == NULL)
+        return false;
+      if (!free_map_allocate (1, &inode->data.indirect_block)) 
+        {
+          free (inode->indirect_block);
+          inode->indirect_block = NULL;
+          return false;
+        } 
+    }
+
+  block = malloc (BLOCK_SECTOR_SIZE);
+  sectorp = extent_block_sector (inode, b);
+  if (block == NULL || !free_map_allocate (1, sectorp))
+    {
+      free (block);
+      if (b == DIRECT_BLOCK_CNT)
+        release_indirect_block (inode);
+      return false;
+    } 
+  inode->extent_blocks[b] = block;
+
+  /* Blocks listed in the inode are written along with it. */
+  if (b >= DIRECT_BLOCK_CNT)
+    cache_write_at (inode->data.indirect_block, BLOCK_IO_INODE, sectorp,
+                    (b - DIRECT_BLOCK_CNT) * sizeof *sectorp,
+                    sizeof *sectorp);
+  return true;
+}
+
+/* Adds an extent of CNT sectors starting at START to the end of
+   INODE's extents, allocating an extent block if needed.
+   Returns false if INODE has no room for another extent. */
+static bool
+append_extent (struct inode *inode, block_sector_t start, size_t cnt)
+{
+  size_t idx = inode->data.extent_cnt;
+  struct extent *e;
+
+  if (idx >= MAX_EXTENTS)
+    return false;
+  if (idx >= INLINE_EXTENTS && (idx - INLINE_EXTENTS) % EXTENTS_PER_BLOCK == 0
+      && !allocate_extent_block (inode,
+                                 (idx - INLINE_EXTENTS) / EXTENTS_PER_BLOCK))
+    return false;
+
+  e = get_extent (inode, idx);
+  e->start = start;
+  e->cnt = cnt;
+  save_extent (inode, idx);
+
+  /* Readers look up extents without locking, so make sure that
+     the extent is complete before it is counted. */
+  barrier ();
+  inode->data.extent_cnt++;
+  return true;
+}
+
+/* Extends INODE's extents until they hold at least CNT sectors,
+   without changing its length.  Returns false if the disk fills
+   up or INODE runs out of extents, keeping the sectors allocated
+   until then.
+
+   Each run is as long as the free map allows, preferably right
+   after INODE's last extent so that the extent just gets
+   longer.  A growing file also gets as many sectors again as it
+   already has, up to PREALLOC_MAX, so that files growing at the
+   same time do not interleave on disk.  Unused preallocated
+   sectors are freed when the file is closed. */
+static bool
+allocate_sectors (struct inode *inode, size_t cnt)
+{
+  struct inode_disk *d = &inode->data;
+
+  while (d->sector_cnt < cnt)
+    {
+      struct extent *last = (d->extent_cnt > 0
+                             ? get_extent (inode, d->extent_cnt - 1) : NULL);
+      size_t want = cnt - d->sector_cnt;
+      block_sector_t goal = 0;
+      block_sector_t start;
+      size_t got;
+
+      if (!inode_extent_alloc)
+        want = 1;
+      else
+        {
+          want += d->sector_cnt < PREALLOC_MAX ? d->sector_cnt : PREALLOC_MAX;
+          if (last != NULL)
+            goal = last->start + last->cnt;
+        } 
+
+      got = free_map_allocate_run (want, goal, &start);
+      if (got == 0)
+        return false;
+      if (last != NULL && last->start + last->cnt == start)
+        {
+          last->cnt += got;
+          save_extent (inode, d->extent_cnt - 1);
+        } 
+      else if (!append_extent (inode, start, got))
+        {
+          free_map_release (start, got);
+          return false;
+        } 
+      d->sector_cnt += got;
+    }
+  return true;
+}
+
+/* Frees INODE's sectors past the first CNT, along with extent
+   blocks, and the indirect block, that no longer hold any
+   extents. */
+static void
+release_sectors (struct inode *inode, size_t cnt)
+{
+  struct inode_disk *d = &inode->data;
+
+  while (d->sector_cnt > cnt)
+    {
+      size_t idx = d->extent_cnt - 1;
+      struct extent *last = get_extent (inode, idx);
+      size_t excess = d->sector_cnt - cnt;
+
+      if (excess < last->cnt)
+        {
+          last->cnt -= excess;
+          free_map_release (last->start + last->cnt, excess);
+          d->sector_cnt -= excess;
+          save_extent (inode, idx);
+          break;
+        } 
+
+      free_map_release (last->start, last->cnt);
+      d->sector_cnt -= last->cnt;
+      d->extent_cnt--;
+      if (idx >= INLINE_EXTENTS && (idx - INLINE_EXTENTS) % EXTENTS_PER_BLOCK == 0)
+        {
+          size_t b = (idx - INLINE_EXTENTS) / EXTENTS_PER_BLOCK;
+          block_sector_t *sectorp = extent_block_sector (inode, b);
+          free_map_release (*sectorp, 1);
+          *sectorp = 0;
+          free (inode->extent_blocks[b]);
+          inode->extent_blocks[b] = NULL;
+          if (b == DIRECT_BLOCK_CNT)
+            release_indirect_block (inode);
+        } 
+    }
+}
+
+/* Makes INODE LENGTH bytes long, if that is longer than it is,
+   zeroing the sectors that become part of the file, except
+   those that are about to be completely overwritten with data
+   for bytes SKIP_START through SKIP_END - 1.  Returns the new
+   length, which is less than LENGTH if the disk fills up.  The
+   caller must hold INODE's grow_lock and must write INODE back
+   to disk. */
+static off_t
+extend (struct inode *inode, off_t length, off_t skip_start, off_t skip_end)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  enum block_io_class class = data_class (inode->sector);
+  size_t old_sectors = bytes_to_sectors (inode->data.length);
+  size_t i;
+
+  if (length <= inode->data.length)
+    return inode->data.length;
+  if (!allocate_sectors (inode, bytes_to_sectors (length)))
+    {
+      /* Use whatever was allocated. */
+      off_t avail = inode->data.sector_cnt * BLOCK_SECTOR_SIZE;
+      if (avail < length)
+        length = avail > inode->data.length ? avail : inode->data.length;
+    }
+
+  for (i = old_sectors; i < bytes_to_sectors (length); i++)
+    {
+      off_t ofs = i * BLOCK_SECTOR_SIZE;
+      if (ofs < skip_start || ofs + BLOCK_SECTOR_SIZE > skip_end)
+        cache_write_at (index_to_sector (inode, i), class, zeros,
+                        0, BLOCK_SECTOR_SIZE);
+    }
+  return length;
+}
+
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.  Most opens find the inode
+   already there, so they only need to hold OPEN_INODES_LOCK for
+   reading. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of in-memory inodes. */
+static struct kmem_cache *inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), 0, NULL);
+  if (inode_cache == NULL)
+    PANIC ("inode_init: out of memory");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -73,6 +482,7 @@ bool
 inode_create (block_sector_t sector, off_t length)
 {
   struct inode_disk *disk_inode = NULL;
+  struct inode *inode;
   bool success = false;
 
   ASSERT (length >= 0);
@@ -81,55 +491,104 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  /* Write an empty inode, then extend it like any other file. */
   disk_inode = calloc (1, sizeof *disk_inode);
-  if (disk_inode != NULL)
+  if (disk_inode == NULL)
+    return false;
+  disk_inode->magic = INODE_MAGIC;
+  cache_write_at (sector, BLOCK_IO_INODE, disk_inode, 0, BLOCK_SECTOR_SIZE);
+  free (disk_inode);
+
+  inode = inode_open (sector);
+  if (inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
-      disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      lock_acquire (&inode->grow_lock);
+      inode->data.length = extend (inode, length, 0, 0);
+      success = inode->data.length == length;
+      if (!success)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
+          inode->data.length = 0;
+          release_sectors (inode, 0);
         } 
-      free (disk_inode);
+      save_inode (inode);
+      lock_release (&inode->grow_lock);
+      inode_close (inode);
     }
   return success;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+   if SECTOR's inode is not open.  OPEN_INODES_LOCK must be held
+   for reading or writing. */
+static struct inode *
+find_open_inode (block_sector_t sector) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode_reopen (inode);
+    }
+  return NULL;
+}
+
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
    Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
+  size_t block_cnt;
+  size_t b = 0;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_acquire_read (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  rwlock_release_read (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
+
+  /* Check again for writing, since another thread may have
+     opened it meanwhile. */
+  rwlock_acquire_write (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  if (inode != NULL)
+    goto done;
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
-    return NULL;
+    goto done;
+
+  /* Read the inode, its indirect block, and its extent blocks. */
+  cache_read_at (sector, BLOCK_IO_INODE, &inode->data,
+                 0, BLOCK_SECTOR_SIZE);
+  block_cnt = extent_block_cnt (inode->data.extent_cnt);
+  inode->indirect_block = NULL;
+  inode->extent_blocks = NULL;
+  inode->hint_extent = inode->hint_first = 0;
+  if (block_cnt > 0 && !allocate_extent_table (inode))
+    goto no_memory;
+  if (block_cnt > DIRECT_BLOCK_CNT) 
+    {
+      inode->indirect_block = malloc (BLOCK_SECTOR_SIZE);
+      if (inode->indirect_block == NULL)
+        goto no_memory;
+      cache_read_at (inode->data.indirect_block, BLOCK_IO_INODE,
+                     inode->indirect_block, 0, BLOCK_SECTOR_SIZE);
+    } 
+  for (b = 0; b < block_cnt; b++)
+    {
+      inode->extent_blocks[b] = malloc (BLOCK_SECTOR_SIZE);
+      if (inode->extent_blocks[b] == NULL)
+        goto no_memory;
+      cache_read_at (*extent_block_sector (inode, b), BLOCK_IO_INODE,
+                     inode->extent_blocks[b], 0, BLOCK_SECTOR_SIZE);
+    }
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
@@ -137,16 +596,31 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  lock_init (&inode->grow_lock);
+
+ done:
+  rwlock_release_write (&open_inodes_lock);
   return inode;
+
+ no_memory:
+  free_extent_blocks (inode);
+  kmem_cache_free (inode_cache, inode);
+  inode = NULL;
+  goto done;
 }
 
-/* Reopens and returns INODE. */
+/* Reopens and returns INODE.  Several threads holding
+   OPEN_INODES_LOCK for reading may reopen INODE at once, so
+   the count is updated with interrupts off. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -158,31 +632,49 @@ inode_get_inumber (const struct inode *inode)
 }
 
 /* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
+   If this was the last reference to INODE, frees its memory and
+   any sectors preallocated past its end.
    If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) 
 {
+  enum intr_level old_level;
+  int open_cnt;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Hold off inode_open() while the last opener writes the inode
+     back, so that opening it again reads the new version. */
+  rwlock_acquire_write (&open_inodes_lock);
+  old_level = intr_disable ();
+  open_cnt = --inode->open_cnt;
+  intr_set_level (old_level);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (open_cnt == 0)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
+
+      /* Deallocate blocks if removed, otherwise preallocated
+         sectors. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
-        }
+          release_sectors (inode, 0);
+        } 
+      else if (inode->data.sector_cnt > bytes_to_sectors (inode->data.length))
+        {
+          release_sectors (inode, bytes_to_sectors (inode->data.length));
+          save_inode (inode);
+        } 
 
-      free (inode); 
+      free_extent_blocks (inode);
+      kmem_cache_free (inode_cache, inode); 
     }
+  rwlock_release_write (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -202,7 +694,6 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
   while (size > 0) 
     {
@@ -220,59 +711,78 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
-      
+      cache_read_at (sector_idx, data_class (inode->sector),
+                     buffer + bytes_read, sector_ofs, chunk_size);
+
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
+/* Starts reading the sectors that hold SIZE bytes of INODE,
+   starting at OFFSET, into the buffer cache in the background.
+   Bytes past the end of INODE are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t size, off_t offset) 
+{
+  off_t end = offset + size;
+  off_t pos;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (pos = offset - offset % BLOCK_SECTOR_SIZE; pos < end;
+       pos += BLOCK_SECTOR_SIZE)
+    cache_read_ahead (byte_to_sector (inode, pos), data_class (inode->sector));
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or an error occurs.
+   Writing past end of file extends the file, filling any gap
+   with zeros.  The new length takes effect only after the data
+   is written, so a concurrent reader sees all of the extension
+   or none of it. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
+  enum block_io_class class = data_class (inode->sector);
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  off_t old_length = 0;
+  off_t limit;
+  bool grow;
 
   if (inode->deny_write_cnt)
     return 0;
 
+  /* Allocate and zero sectors for an extension, but publish the
+     new length only below.  Only one thread at a time may
+     extend INODE. */
+  grow = offset + size > inode_length (inode);
+  if (grow) 
+    {
+      lock_acquire (&inode->grow_lock);
+      old_length = inode->data.length;
+      limit = extend (inode, offset + size, offset, offset + size);
+      inode->data.length = old_length;
+    }
+  else
+    limit = inode_length (inode);
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = index_to_sector (inode,
+                                                   offset / BLOCK_SECTOR_SIZE);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = limit - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -281,38 +791,24 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      cache_write_at (sector_idx, class, buffer + bytes_written,
+                      sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Publish the new length and extents. */
+  if (grow) 
+    {
+      barrier ();
+      if (bytes_written > 0 && offset > old_length)
+        inode->data.length = offset;
+      save_inode (inode);
+      lock_release (&inode->grow_lock);
+    }
 
   return bytes_written;
 }
@@ -343,3 +839,24 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns the number of extents holding INODE's data. */
+size_t
+inode_extent_cnt (const struct inode *inode)
+{
+  return inode->data.extent_cnt;
+}
+
+/* Stores the first sector and the number of sectors in extent
+   IDX of INODE into *START and *CNT. */
+void
+inode_get_extent (const struct inode *inode, size_t idx,
+                  block_sector_t *start, size_t *cnt)
+{
+  const struct extent *e;
+
+  ASSERT (idx < inode_extent_cnt (inode));
+  e = get_extent (inode, idx);
+  *start = e->start;
+  *cnt = e->cnt;
+}
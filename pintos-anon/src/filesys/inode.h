@@ -7,6 +7,9 @@
 
 struct bitmap;
 
+/* Allocate file data in runs, with preallocation? */
+extern bool inode_extent_alloc;
+
 void inode_init (void);
 bool inode_create (block_sector_t, off_t);
 struct inode *inode_open (block_sector_t);
@@ -15,9 +18,13 @@ block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+void inode_read_ahead (struct inode *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+size_t inode_extent_cnt (const struct inode *);
+void inode_get_extent (const struct inode *, size_t idx,
+                       block_sector_t *start, size_t *cnt);
 
 #endif /* filesys/inode.h */
@@ -1,5 +1,74 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* Replacements for large memcpy() and memset() calls. */
+void *(*memcpy_hook) (void *, const void *, size_t);
+void *(*memset_hook) (void *, int, size_t);
+
+/* Blocks shorter than this are handled a byte at a time, since
+   setting up the string instructions would cost more. */
+#define SHORT_BLOCK 16
+
+/* A word that may alias any other type. */
+typedef uint32_t __attribute__ ((may_alias)) alias_word;
+
+/* Copies SIZE bytes from SRC to DST, lowest address first:
+   bytes up to a word boundary of DST, then words with `rep
+   movsl', then the remaining bytes.  See [IA32-v2b] "MOVS". */
+static inline void
+copy_up (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  size_t head, words;
+
+  if (size < SHORT_BLOCK)
+    {
+      while (size-- > 0)
+        *dst++ = *src++;
+      return;
+    }
+
+  head = -(uintptr_t) dst & 3;
+  words = (size - head) / 4;
+  size = (size - head) & 3;
+  asm volatile ("rep movsb; movl %3, %%ecx; rep movsl; movl %4, %%ecx; "
+                "rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (head)
+                : "g" (words), "g" (size)
+                : "memory");
+}
+
+/* Copies SIZE bytes from SRC to DST, highest address first, in
+   the same way as copy_up(). */
+static inline void
+copy_down (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  size_t tail, words;
+
+  dst += size;
+  src += size;
+  if (size < SHORT_BLOCK)
+    {
+      while (size-- > 0)
+        *--dst = *--src;
+      return;
+    }
+
+  /* With the direction flag set, the string instructions move
+     downward from the addresses in ESI and EDI.  Interrupt
+     handlers clear the flag on entry, and `iret' restores it. */
+  tail = (uintptr_t) dst & 3;
+  words = (size - tail) / 4;
+  size = (size - tail) & 3;
+  dst--;
+  src--;
+  asm volatile ("std; rep movsb; subl $3, %%edi; subl $3, %%esi; "
+                "movl %3, %%ecx; rep movsl; addl $3, %%edi; "
+                "addl $3, %%esi; movl %4, %%ecx; rep movsb; cld"
+                : "+D" (dst), "+S" (src), "+c" (tail)
+                : "g" (words), "g" (size)
+                : "memory");
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,9 +81,9 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
-
+  if (size >= STRING_HOOK_MIN && memcpy_hook != NULL)
+    return memcpy_hook (dst_, src_, size);
+  copy_up (dst, src, size);
   return dst_;
 }
 
@@ -29,20 +98,14 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
-    {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
-    }
+  if (dst >= src + size || src >= dst + size)
+    return memcpy (dst, src, size);
+  else if (dst < src)
+    copy_up (dst, src, size);
+  else
+    copy_down (dst, src, size);
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +121,10 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip equal words, then find the differing byte. */
+  for (; size >= 4; a += 4, b += 4, size -= 4)
+    if (*(const alias_word *) a != *(const alias_word *) b)
+      break;
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -274,17 +341,36 @@ strtok_r (char *s, const char *delimiters, char **save_ptr)
   return token;
 }
 
-/* Sets the SIZE bytes in DST to VALUE. */
+/* Sets the SIZE bytes in DST to VALUE, a word at a time with
+   `rep stosl' once DST is word-aligned.  See [IA32-v2b] "STOS".
+   Returns DST. */
 void *
 memset (void *dst_, int value, size_t size) 
 {
   unsigned char *dst = dst_;
+  size_t head, words;
+  uint32_t fill;
 
   ASSERT (dst != NULL || size == 0);
-  
-  while (size-- > 0)
-    *dst++ = value;
 
+  if (size >= STRING_HOOK_MIN && memset_hook != NULL)
+    return memset_hook (dst_, value, size);
+  if (size < SHORT_BLOCK)
+    {
+      while (size-- > 0)
+        *dst++ = value;
+      return dst_;
+    }
+
+  fill = (unsigned char) value * 0x01010101u;
+  head = -(uintptr_t) dst & 3;
+  words = (size - head) / 4;
+  size = (size - head) & 3;
+  asm volatile ("rep stosb; movl %2, %%ecx; rep stosl; movl %3, %%ecx; "
+                "rep stosb"
+                : "+D" (dst), "+c" (head)
+                : "g" (words), "g" (size), "a" (fill)
+                : "memory");
   return dst_;
 }
 
@@ -25,6 +25,13 @@ size_t strlcat (char *, const char *, size_t);
 char *strtok_r (char *, const char *, char **);
 size_t strnlen (const char *, size_t);
 
+/* Replacements for memcpy() and memset() on blocks of at least
+   STRING_HOOK_MIN bytes, used if non-null.  The kernel installs
+   SSE2 versions at boot if the CPU supports them. */
+#define STRING_HOOK_MIN 512
+extern void *(*memcpy_hook) (void *, const void *, size_t);
+extern void *(*memset_hook) (void *, int, size_t);
+
 /* Try to be helpful. */
 #define strcpy dont_use_strcpy_use_strlcpy
 #define strncpy dont_use_strncpy_use_strlcpy
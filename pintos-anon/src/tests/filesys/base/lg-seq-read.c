@@ -0,0 +1,8 @@
+/* Writes out a file four times the size of the default buffer
+   cache, then reads it back sequentially to verify it.  By the
+   time it is read, the start of the file has been evicted, so
+   the reads should be served from sectors read ahead. */
+
+#define TEST_SIZE 131072
+#define BLOCK_SIZE 4096
+#include "tests/filesys/base/seq-block.inc"
@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-seq-read) begin
+(lg-seq-read) create "noodle"
+(lg-seq-read) open "noodle"
+(lg-seq-read) writing "noodle"
+(lg-seq-read) close "noodle"
+(lg-seq-read) open "noodle" for verification
+(lg-seq-read) verified contents of "noodle"
+(lg-seq-read) close "noodle"
+(lg-seq-read) end
+EOF
+
+# The file is read back in 512-byte reads that continue one
+# another, so some of the sectors read ahead must be used.
+my (@output) = read_text_file ("$test.output");
+my ($ra_cnt, $ra_used) = map (/^Read-ahead: (\d+) sectors, (\d+) used$/,
+			      @output);
+fail "missing read-ahead statistics\n" if !defined $ra_used;
+fail "none of the $ra_cnt sectors read ahead were used\n"
+  if $ra_used == 0;
+pass;
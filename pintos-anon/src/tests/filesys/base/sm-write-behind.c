@@ -0,0 +1,24 @@
+/* Creates an empty file and appends to it sequentially, 16 bytes
+   at a time, then reads it back to verify that it was written
+   properly.  With write-behind, the disk should see far fewer
+   sector writes than there were write calls, even though every
+   call also extends the file. */
+
+#include "tests/filesys/seq-test.h"
+#include "tests/main.h"
+
+static char buf[10240];
+
+static size_t
+return_block_size (void) 
+{
+  return 16;
+}
+
+void
+test_main (void) 
+{
+  seq_test ("noodle",
+            buf, sizeof buf, 0,
+            return_block_size, NULL);
+}
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-write-behind) begin
+(sm-write-behind) create "noodle"
+(sm-write-behind) open "noodle"
+(sm-write-behind) writing "noodle"
+(sm-write-behind) close "noodle"
+(sm-write-behind) open "noodle" for verification
+(sm-write-behind) verified contents of "noodle"
+(sm-write-behind) close "noodle"
+(sm-write-behind) end
+EOF
+
+# The test makes 10240 / 16 = 640 write calls, each of which
+# extends the file.  The file system device's sector writes also
+# include copying in the test program, but without write-behind
+# the write calls alone would account for 640 of them, plus the
+# inode updates for every extension.
+my (@output) = read_text_file ("$test.output");
+my ($writes) = map (/\(filesys\): \d+ reads in \d+ requests, (\d+) writes/,
+		    @output);
+fail "missing file system device statistics\n" if !defined $writes;
+fail "$writes sectors written for 640 writes of 16 bytes each\n"
+  if $writes >= 640;
+pass;
@@ -0,0 +1,63 @@
+/* Arms four kernel timers, cancels one and moves another
+   earlier, and checks that the remaining callbacks run in expiry
+   order, outside interrupt context, where they may take locks. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static struct lock lock;
+static struct semaphore done;
+
+static void callback (void *name_);
+
+void
+test_alarm_callback (void) 
+{
+  struct kernel_timer a, b, c, d;
+  int64_t start;
+  int i;
+
+  lock_init (&lock);
+  sema_init (&done, 0);
+
+  timer_setup (&a, callback, "a");
+  timer_setup (&b, callback, "b");
+  timer_setup (&c, callback, "c");
+  timer_setup (&d, callback, "d");
+
+  start = timer_ticks ();
+  timer_add (&a, start + 30);
+  timer_add (&b, start + 10);
+  timer_add (&c, start + 20);
+  timer_add (&d, start + 40);
+
+  if (!timer_del (&c))
+    fail ("timer c should have been pending");
+  if (!timer_mod (&d, start + 5))
+    fail ("timer d should have been pending");
+  msg ("Cancelled timer c, moved timer d before b.");
+
+  for (i = 0; i < 3; i++)
+    sema_down (&done);
+
+  if (timer_pending (&a) || timer_pending (&b)
+      || timer_pending (&c) || timer_pending (&d))
+    fail ("no timer should still be pending");
+  msg ("No timers pending.");
+}
+
+static void
+callback (void *name_) 
+{
+  const char *name = name_;
+
+  ASSERT (!intr_context ());
+  lock_acquire (&lock);
+  msg ("Timer %s fired.", name);
+  lock_release (&lock);
+  sema_up (&done);
+}
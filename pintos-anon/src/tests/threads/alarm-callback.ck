@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-callback) begin
+(alarm-callback) Cancelled timer c, moved timer d before b.
+(alarm-callback) Timer d fired.
+(alarm-callback) Timer b fired.
+(alarm-callback) Timer a fired.
+(alarm-callback) No timers pending.
+(alarm-callback) end
+EOF
+pass;
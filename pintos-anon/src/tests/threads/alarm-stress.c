@@ -0,0 +1,74 @@
+/* Puts 10,000 threads to sleep at once, with wake-up times
+   spread over 1,000 ticks, and reports how many CPU cycles the
+   timer interrupt handler spent per tick while they were
+   asleep.  With a timing wheel, arming and expiring each alarm
+   is constant time, so the per-tick cost should stay flat no
+   matter how many threads are sleeping. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 10000
+#define SPREAD 1000
+
+static int64_t wake_base;
+static struct semaphore start;
+static struct semaphore done;
+
+static void sleeper (void *);
+
+void
+test_alarm_stress (void) 
+{
+  struct timer_cycle_stats stats;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep over %d ticks.", SLEEPER_CNT, SPREAD);
+  sema_init (&start, 0);
+  sema_init (&done, 0);
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper,
+                         (void *) (intptr_t) i) == TID_ERROR)
+        fail ("thread_create() failed for thread %d", i);
+    }
+
+  /* Creating the sleepers takes many time slices, so they wait
+     on START until all of them exist and WAKE_BASE is set.  Then
+     they all go to sleep at once. */
+  wake_base = timer_ticks () + TIMER_FREQ;
+  timer_reset_cycle_stats ();
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_up (&start);
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  timer_get_cycle_stats (&stats);
+
+  msg ("All %d sleepers woke up.", SLEEPER_CNT);
+  printf ("Timer interrupt: %"PRId64" ticks, %"PRIu64" cycles average, "
+          "%"PRIu64" cycles max\n",
+          stats.cnt, stats.cnt > 0 ? stats.total / stats.cnt : 0,
+          stats.max);
+  pass ();
+}
+
+static void
+sleeper (void *idx_) 
+{
+  int idx = (intptr_t) idx_;
+
+  sema_down (&start);
+  timer_sleep (wake_base + idx % SPREAD - timer_ticks ());
+  sema_up (&done);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(alarm-stress) PASS', @output);
+fail "missing timer interrupt cycle report"
+  unless grep (/^Timer interrupt: \d+ ticks, \d+ cycles average, \d+ cycles max$/, @output);
+
+pass;
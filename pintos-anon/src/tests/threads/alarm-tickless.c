@@ -0,0 +1,53 @@
+/* Counts timer interrupts during one second in which the CPU is
+   idle, first with the periodic tick and then with tickless
+   idle, and checks that tickless idle takes far fewer of them
+   without making the sleep any shorter or longer. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static int64_t idle_second (bool tickless);
+
+void
+test_alarm_tickless (void) 
+{
+  bool saved = timer_tickless;
+  int64_t periodic, tickless;
+
+  periodic = idle_second (false);
+  tickless = idle_second (true);
+  timer_tickless = saved;
+
+  printf ("Periodic tick: %"PRId64" interrupts per idle second\n", periodic);
+  printf ("Tickless idle: %"PRId64" interrupts per idle second\n", tickless);
+  if (tickless * 2 > periodic)
+    fail ("tickless idle saved too few timer interrupts");
+  pass ();
+}
+
+/* Sleeps for one second with timer_tickless set to TICKLESS and
+   returns the number of timer interrupts taken meanwhile. */
+static int64_t
+idle_second (bool tickless)
+{
+  struct timer_cycle_stats stats;
+  int64_t start;
+
+  timer_tickless = tickless;
+
+  /* Start at the beginning of a timer tick. */
+  timer_sleep (1);
+
+  timer_reset_cycle_stats ();
+  start = timer_ticks ();
+  timer_sleep (TIMER_FREQ);
+  if (timer_elapsed (start) != TIMER_FREQ)
+    fail ("slept %"PRId64" ticks instead of %d",
+          timer_elapsed (start), TIMER_FREQ);
+  timer_get_cycle_stats (&stats);
+  return stats.cnt;
+}
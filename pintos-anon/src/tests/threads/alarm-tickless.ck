@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(alarm-tickless) PASS', @output);
+fail "missing interrupt counts"
+  unless grep (/^Periodic tick: \d+ interrupts per idle second$/, @output)
+    && grep (/^Tickless idle: \d+ interrupts per idle second$/, @output);
+
+pass;
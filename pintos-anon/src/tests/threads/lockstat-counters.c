@@ -0,0 +1,77 @@
+/* Checks the lock statistics kept with lockstat_enabled set.
+   The main thread acquires a lock three times without
+   contention, then holds it across a sleep while a
+   higher-priority thread waits for it, and checks the counters
+   kept for the lock's call site. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define HOLD_TICKS 10
+
+static thread_func waiter_thread_func;
+
+void
+test_lockstat_counters (void) 
+{
+  bool saved = lockstat_enabled;
+  struct lock_stats *stats;
+  struct lock lock;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lockstat_enabled = false;
+  lock_init (&lock);
+  if (lock.stats != NULL)
+    fail ("statistics kept with lockstat disabled");
+  msg ("No statistics are kept with lockstat disabled.");
+
+  lockstat_enabled = true;
+  lock_init (&lock);
+  lockstat_enabled = saved;
+  stats = lock.stats;
+  if (stats == NULL)
+    fail ("no statistics kept with lockstat enabled");
+  lock_set_name (&lock, "lockstat-test");
+
+  for (i = 0; i < 3; i++)
+    {
+      lock_acquire (&lock);
+      lock_release (&lock);
+    }
+  msg ("acquired %llu, contended %llu", stats->acquired, stats->contended);
+
+  /* Start at the beginning of a timer tick. */
+  timer_sleep (1);
+
+  lock_acquire (&lock);
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter_thread_func, &lock);
+  timer_sleep (HOLD_TICKS);
+  lock_release (&lock);
+  msg ("acquired %llu, contended %llu", stats->acquired, stats->contended);
+
+  if (stats->max_wait_ticks < HOLD_TICKS
+      || stats->wait_ticks != stats->max_wait_ticks)
+    fail ("waited %lld ticks at most, %lld in total",
+          stats->max_wait_ticks, stats->wait_ticks);
+  msg ("The waiter waited at least %d ticks.", HOLD_TICKS);
+  if (stats->hold_ticks < HOLD_TICKS)
+    fail ("held %lld ticks in total", stats->hold_ticks);
+  msg ("The lock was held at least %d ticks.", HOLD_TICKS);
+}
+
+static void
+waiter_thread_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  msg ("waiter: got the lock");
+  lock_release (lock);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lockstat-counters) begin
+(lockstat-counters) No statistics are kept with lockstat disabled.
+(lockstat-counters) acquired 3, contended 0
+(lockstat-counters) waiter: got the lock
+(lockstat-counters) acquired 5, contended 1
+(lockstat-counters) The waiter waited at least 10 ticks.
+(lockstat-counters) The lock was held at least 10 ticks.
+(lockstat-counters) end
+EOF
+pass;
@@ -0,0 +1,134 @@
+/* Runs THREAD_CNT threads that each malloc() and free() a small
+   block PAIR_CNT times, first straight from malloc()'s shared
+   descriptors and then through per-thread magazines, and reports
+   the cycles per pair.  Each thread checks that no one else
+   writes to its blocks.
+
+   Before its pairs, each thread also allocates and then frees a
+   burst of BURST_CNT blocks.  With magazines on, every malloc()
+   must be served from a magazine, and only the burst may make a
+   magazine go back to its descriptor, MAGAZINE_SIZE / 2 blocks
+   per trip. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 8
+#define PAIR_CNT 2000
+#define BLOCK_SIZE 64
+#define BURST_CNT (4 * MAGAZINE_SIZE)
+
+static thread_func alloc_thread;
+static uint64_t run_threads (bool magazines,
+                             struct malloc_magazine_stats *);
+
+void
+test_malloc_magazine (void) 
+{
+  bool saved = malloc_magazines;
+  struct malloc_magazine_stats off, on;
+  uint64_t shared, cached;
+
+  shared = run_threads (false, &off);
+  cached = run_threads (true, &on);
+  malloc_magazines = saved;
+
+  if (off.hits != 0 || off.refills != 0 || off.drains != 0)
+    fail ("magazines used while disabled: %llu hits, %llu refills, "
+          "%llu drains", off.hits, off.refills, off.drains);
+  if (on.hits != THREAD_CNT * (BURST_CNT + PAIR_CNT))
+    fail ("%llu magazine hits, expected %d",
+          on.hits, THREAD_CNT * (BURST_CNT + PAIR_CNT));
+  if (on.refills != THREAD_CNT * (BURST_CNT / (MAGAZINE_SIZE / 2)))
+    fail ("%llu magazine refills, expected %d", on.refills,
+          THREAD_CNT * (BURST_CNT / (MAGAZINE_SIZE / 2)));
+  if (on.drains != THREAD_CNT * ((BURST_CNT - MAGAZINE_SIZE)
+                                 / (MAGAZINE_SIZE / 2)))
+    fail ("%llu magazine drains, expected %d", on.drains,
+          THREAD_CNT * ((BURST_CNT - MAGAZINE_SIZE)
+                        / (MAGAZINE_SIZE / 2)));
+
+  printf ("malloc/free without magazines: %"PRIu64" cycles per pair\n",
+          shared / (THREAD_CNT * PAIR_CNT));
+  printf ("malloc/free with magazines: %"PRIu64" cycles per pair\n",
+          cached / (THREAD_CNT * PAIR_CNT));
+  pass ();
+}
+
+/* Runs THREAD_CNT allocating threads to completion with
+   malloc_magazines set to MAGAZINES, stores how the magazine
+   statistics changed meanwhile in *STATS, and returns the number
+   of cycles the threads took. */
+static uint64_t
+run_threads (bool magazines, struct malloc_magazine_stats *stats)
+{
+  struct malloc_magazine_stats before;
+  struct semaphore done;
+  uint64_t start, cycles;
+  int i;
+
+  malloc_magazines = magazines;
+  sema_init (&done, 0);
+
+  malloc_get_magazine_stats (&before);
+  start = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "alloc %d", i);
+      thread_create (name, PRI_DEFAULT, alloc_thread, &done);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  cycles = rdtsc () - start;
+  malloc_get_magazine_stats (stats);
+
+  stats->hits -= before.hits;
+  stats->refills -= before.refills;
+  stats->drains -= before.drains;
+  return cycles;
+}
+
+static void
+alloc_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  char *burst[BURST_CNT];
+  int id = thread_tid ();
+  int i;
+
+  /* A fresh thread's magazine starts out empty, so this refills
+     it BURST_CNT / (MAGAZINE_SIZE / 2) times, then fills it and
+     drains it once per MAGAZINE_SIZE / 2 blocks after that. */
+  for (i = 0; i < BURST_CNT; i++)
+    if ((burst[i] = malloc (BLOCK_SIZE)) == NULL)
+      fail ("malloc failed");
+  for (i = 0; i < BURST_CNT; i++)
+    free (burst[i]);
+
+  for (i = 0; i < PAIR_CNT; i++)
+    {
+      char *p = malloc (BLOCK_SIZE);
+      int j;
+
+      if (p == NULL)
+        fail ("malloc failed");
+      memset (p, id, BLOCK_SIZE);
+
+      /* Now and then, let another thread allocate meanwhile. */
+      if (i % 100 == 0)
+        thread_yield ();
+      for (j = 0; j < BLOCK_SIZE; j++)
+        if (p[j] != (char) id)
+          fail ("block overwritten by another thread");
+      free (p);
+    }
+  sema_up (done);
+}
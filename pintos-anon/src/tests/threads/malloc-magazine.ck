@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(malloc-magazine) PASS', @output);
+fail "missing malloc timings"
+  unless grep (/^malloc\/free without magazines: \d+ cycles per pair$/,
+               @output)
+    && grep (/^malloc\/free with magazines: \d+ cycles per pair$/, @output);
+
+pass;
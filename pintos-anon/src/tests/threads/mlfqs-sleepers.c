@@ -0,0 +1,72 @@
+/* Checks that the once-a-second MLFQS update does work
+   proportional to the number of runnable threads, not to the
+   number of threads in the system.
+
+   The main thread creates SLEEPER_CNT threads that all sleep
+   for several seconds, then spins for 5 seconds.  During that
+   time only the main thread is runnable, so no per-second update
+   should visit more than a handful of threads.  Afterward all of
+   the sleepers must still wake up, which exercises the lazy
+   recent_cpu decay done on wakeup. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 1000
+#define WORK_BOUND 4
+
+static int64_t wake_time;
+static struct semaphore done;
+
+static void sleeper (void *);
+
+void
+test_mlfqs_sleepers (void) 
+{
+  int64_t start_time;
+  size_t work;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  msg ("Creating %d sleeping threads.", SLEEPER_CNT);
+  sema_init (&done, 0);
+  wake_time = timer_ticks () + 10 * TIMER_FREQ;
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, NULL) == TID_ERROR)
+        fail ("thread_create() failed for thread %d", i);
+    }
+
+  /* Give every sleeper a chance to reach timer_sleep(). */
+  timer_sleep (TIMER_FREQ);
+  thread_mlfqs_reset_max_work ();
+
+  msg ("Main thread spinning for 5 seconds...");
+  start_time = timer_ticks ();
+  while (timer_elapsed (start_time) < 5 * TIMER_FREQ)
+    continue;
+
+  work = thread_mlfqs_max_work ();
+  if (work > WORK_BOUND)
+    fail ("per-second update visited %zu threads, expected at most %d",
+          work, WORK_BOUND);
+  msg ("Per-second update visited at most %d threads.", WORK_BOUND);
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  msg ("All %d sleepers woke up.", SLEEPER_CNT);
+}
+
+static void
+sleeper (void *aux UNUSED) 
+{
+  timer_sleep (wake_time - timer_ticks ());
+  sema_up (&done);
+}
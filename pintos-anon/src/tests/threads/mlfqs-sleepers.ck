@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs-sleepers) begin
+(mlfqs-sleepers) Creating 1000 sleeping threads.
+(mlfqs-sleepers) Main thread spinning for 5 seconds...
+(mlfqs-sleepers) Per-second update visited at most 4 threads.
+(mlfqs-sleepers) All 1000 sleepers woke up.
+(mlfqs-sleepers) end
+EOF
+pass;
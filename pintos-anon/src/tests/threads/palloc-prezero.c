@@ -0,0 +1,85 @@
+/* Measures the latency of thread_create(), which allocates each
+   new thread's page with PAL_ZERO, with the idle thread's
+   pre-zeroed page reserve turned off and then on, and checks
+   that the reserve missed and hit, respectively, every time. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 16
+
+static thread_func exit_thread;
+static uint64_t create_threads (bool prezero,
+                                struct palloc_zero_stats *);
+
+void
+test_palloc_prezero (void) 
+{
+  bool saved = palloc_prezero;
+  struct palloc_zero_stats off, on;
+  uint64_t off_cycles, on_cycles;
+
+  off_cycles = create_threads (false, &off);
+  on_cycles = create_threads (true, &on);
+  palloc_prezero = saved;
+
+  printf ("thread_create without pre-zeroing: %"PRIu64" cycles\n",
+          off_cycles / THREAD_CNT);
+  printf ("thread_create with pre-zeroing: %"PRIu64" cycles\n",
+          on_cycles / THREAD_CNT);
+  if (off.hits != 0 || off.misses != 0)
+    fail ("reserve was used while turned off");
+  if (on.hits != THREAD_CNT || on.misses != 0)
+    fail ("reserve had %llu hits and %llu misses for %d threads",
+          on.hits, on.misses, THREAD_CNT);
+  pass ();
+}
+
+/* Creates THREAD_CNT threads with palloc_prezero set to PREZERO,
+   waits for them to exit, and returns the total number of
+   cycles spent in thread_create().  Stores the reserve's hits
+   and misses meanwhile into *STATS. */
+static uint64_t
+create_threads (bool prezero, struct palloc_zero_stats *stats)
+{
+  struct palloc_zero_stats before, after;
+  struct semaphore done;
+  uint64_t cycles = 0;
+  int i;
+
+  palloc_prezero = prezero;
+  sema_init (&done, 0);
+
+  /* Let the idle thread fill the reserve. */
+  timer_sleep (TIMER_FREQ / 10);
+
+  palloc_get_zero_stats (&before);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      thread_create ("exit", PRI_MIN, exit_thread, &done);
+      cycles += rdtsc () - start;
+    }
+  palloc_get_zero_stats (&after);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  stats->hits = after.hits - before.hits;
+  stats->misses = after.misses - before.misses;
+  return cycles;
+}
+
+static void
+exit_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  sema_up (done);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(palloc-prezero) PASS', @output);
+fail "missing thread_create timings"
+  unless grep (/^thread_create without pre-zeroing: \d+ cycles$/, @output)
+    && grep (/^thread_create with pre-zeroing: \d+ cycles$/, @output);
+
+pass;
@@ -0,0 +1,61 @@
+/* The main thread acquires a readers-writer lock for writing.
+   Then it creates a higher-priority reader and a still higher
+   priority writer that both block on the lock, donating their
+   priorities to the main thread.  When the main thread releases
+   the lock, the writer and then the reader should get it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_write (&rw);
+  thread_create ("reader", PRI_DEFAULT + 3, reader_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  thread_create ("writer", PRI_DEFAULT + 6, writer_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 6, thread_get_priority ());
+  rwlock_release_write (&rw);
+  msg ("writer, reader must already have finished, in that order.");
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("reader: got the lock");
+  rwlock_release_read (rw);
+  msg ("reader: done");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("writer: got the lock");
+  rwlock_release_write (rw);
+  msg ("writer: done");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) This thread should have priority 34.  Actual priority: 34.
+(rwlock-donate) This thread should have priority 37.  Actual priority: 37.
+(rwlock-donate) writer: got the lock
+(rwlock-donate) writer: done
+(rwlock-donate) reader: got the lock
+(rwlock-donate) reader: done
+(rwlock-donate) writer, reader must already have finished, in that order.
+(rwlock-donate) This thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) end
+EOF
+pass;
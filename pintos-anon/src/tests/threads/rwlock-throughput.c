@@ -0,0 +1,100 @@
+/* Runs READER_CNT threads that each read a shared structure
+   ROUND_CNT times, holding it for HOLD_TICKS per read, first
+   under a lock and then under a readers-writer lock.  The lock
+   lets only one reader in at a time, but the readers-writer lock
+   lets them all overlap, so the readers should finish many times
+   sooner. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 8
+#define ROUND_CNT 3
+#define HOLD_TICKS 10
+
+/* Shared by the readers of one run. */
+struct reader_run
+  {
+    bool use_rwlock;            /* Read under RWLOCK or under LOCK? */
+    struct lock lock;
+    struct rwlock rwlock;
+    struct semaphore done;      /* Upped by each reader as it ends. */
+  };
+
+static thread_func reader;
+static int64_t run_readers (bool use_rwlock);
+
+void
+test_rwlock_throughput (void) 
+{
+  int64_t locked, shared;
+
+  locked = run_readers (false);
+  shared = run_readers (true);
+
+  printf ("%d readers under a lock: %"PRId64" ticks\n",
+          READER_CNT, locked);
+  printf ("%d readers under a rwlock: %"PRId64" ticks\n",
+          READER_CNT, shared);
+  if (shared * (READER_CNT / 2) > locked)
+    fail ("readers did not overlap under the rwlock");
+  pass ();
+}
+
+/* Runs READER_CNT readers to completion and returns the number
+   of ticks they took. */
+static int64_t
+run_readers (bool use_rwlock)
+{
+  struct reader_run run;
+  int64_t start;
+  int i;
+
+  run.use_rwlock = use_rwlock;
+  lock_init (&run.lock);
+  rwlock_init (&run.rwlock);
+  sema_init (&run.done, 0);
+
+  /* Start at the beginning of a timer tick. */
+  timer_sleep (1);
+
+  start = timer_ticks ();
+  for (i = 0; i < READER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, reader, &run);
+    }
+  for (i = 0; i < READER_CNT; i++)
+    sema_down (&run.done);
+  return timer_elapsed (start);
+}
+
+static void
+reader (void *run_) 
+{
+  struct reader_run *run = run_;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      if (run->use_rwlock)
+        {
+          rwlock_acquire_read (&run->rwlock);
+          timer_sleep (HOLD_TICKS);
+          rwlock_release_read (&run->rwlock);
+        }
+      else
+        {
+          lock_acquire (&run->lock);
+          timer_sleep (HOLD_TICKS);
+          lock_release (&run->lock);
+        }
+    }
+  sema_up (&run->done);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(rwlock-throughput) PASS', @output);
+fail "missing reader timings"
+  unless grep (/^\d+ readers under a lock: \d+ ticks$/, @output)
+    && grep (/^\d+ readers under a rwlock: \d+ ticks$/, @output);
+
+pass;
@@ -0,0 +1,79 @@
+/* Checks the try, upgrade and downgrade variants of the
+   readers-writer lock: readers share the lock, a waiting writer
+   keeps new readers and upgrades out, the only reader may
+   upgrade, and a downgrade lets waiting readers in at once. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_upgrade (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  if (!rwlock_try_acquire_read (&rw))
+    fail ("try_acquire_read failed alongside a reader");
+  msg ("try_acquire_read succeeds alongside a reader.");
+  rwlock_release_read (&rw);
+  if (rwlock_try_acquire_write (&rw))
+    fail ("try_acquire_write succeeded while a reader held the lock");
+  msg ("try_acquire_write fails while a reader holds the lock.");
+
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+  msg ("writer is waiting for us to stop reading.");
+  if (rwlock_try_acquire_read (&rw))
+    fail ("try_acquire_read succeeded while a writer waited");
+  msg ("try_acquire_read fails while a writer waits.");
+  if (rwlock_try_upgrade (&rw))
+    fail ("try_upgrade succeeded while a writer waited");
+  msg ("try_upgrade fails while a writer waits.");
+  rwlock_release_read (&rw);
+  msg ("writer must already have finished.");
+
+  rwlock_acquire_read (&rw);
+  if (!rwlock_try_upgrade (&rw) || !rwlock_held_for_write (&rw))
+    fail ("try_upgrade failed for the only reader");
+  msg ("try_upgrade succeeds for the only reader.");
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  rwlock_downgrade (&rw);
+  msg ("reader must already have finished.");
+  rwlock_release_read (&rw);
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("reader: got the lock alongside the downgraded writer");
+  rwlock_release_read (rw);
+  msg ("reader: done");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("writer: got the lock");
+  rwlock_release_write (rw);
+  msg ("writer: done");
+}
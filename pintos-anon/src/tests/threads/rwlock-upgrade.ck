@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-upgrade) begin
+(rwlock-upgrade) try_acquire_read succeeds alongside a reader.
+(rwlock-upgrade) try_acquire_write fails while a reader holds the lock.
+(rwlock-upgrade) writer is waiting for us to stop reading.
+(rwlock-upgrade) try_acquire_read fails while a writer waits.
+(rwlock-upgrade) try_upgrade fails while a writer waits.
+(rwlock-upgrade) writer: got the lock
+(rwlock-upgrade) writer: done
+(rwlock-upgrade) writer must already have finished.
+(rwlock-upgrade) try_upgrade succeeds for the only reader.
+(rwlock-upgrade) This thread should have priority 32.  Actual priority: 32.
+(rwlock-upgrade) reader: got the lock alongside the downgraded writer
+(rwlock-upgrade) reader: done
+(rwlock-upgrade) reader must already have finished.
+(rwlock-upgrade) end
+EOF
+pass;
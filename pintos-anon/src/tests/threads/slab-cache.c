@@ -0,0 +1,113 @@
+/* Allocates many objects from a slab cache with a constructor
+   and checks that they are constructed, aligned and disjoint,
+   that successive slabs are colored differently, and that a
+   freed object comes back still constructed. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_CNT 200
+#define OBJ_ALIGN 16
+#define OBJ_MAGIC 0x0b1ec7ed
+
+/* A test object, of a size that is not a power of 2. */
+struct object
+  {
+    unsigned magic;             /* Set by the constructor. */
+    int id;                     /* Index in objs[]. */
+    char data[92];
+  };
+
+static struct object *objs[OBJ_CNT];
+static int ctor_cnt;
+
+static kmem_ctor construct;
+
+void
+test_slab_cache (void) 
+{
+  struct kmem_cache *cache;
+  struct object *o;
+  uintptr_t first_ofs = 0;
+  bool colored = false;
+  int i, ctor_before;
+
+  cache = kmem_cache_create ("test", sizeof (struct object), OBJ_ALIGN,
+                             construct);
+  if (cache == NULL)
+    fail ("kmem_cache_create failed");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      o = objs[i] = kmem_cache_alloc (cache);
+      if (o == NULL)
+        fail ("kmem_cache_alloc failed");
+      if (o->magic != OBJ_MAGIC)
+        fail ("object %d not constructed", i);
+      if ((uintptr_t) o % OBJ_ALIGN != 0)
+        fail ("object %d misaligned at %p", i, o);
+      o->id = i;
+      memset (o->data, i, sizeof o->data);
+    }
+  msg ("Allocated %d constructed, aligned objects.", OBJ_CNT);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      size_t j;
+
+      o = objs[i];
+      if (o->id != i)
+        fail ("object %d overwritten", i);
+      for (j = 0; j < sizeof o->data; j++)
+        if (o->data[j] != (char) i)
+          fail ("object %d overwritten", i);
+    }
+  msg ("No two objects overlap.");
+
+  /* The first object of each slab is the one with the lowest
+     page offset on its page. */
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      uintptr_t ofs = pg_ofs (objs[i]);
+      int j;
+
+      for (j = 0; j < OBJ_CNT; j++)
+        if (pg_round_down (objs[j]) == pg_round_down (objs[i])
+            && pg_ofs (objs[j]) < ofs)
+          break;
+      if (j < OBJ_CNT)
+        continue;
+      if (first_ofs == 0)
+        first_ofs = ofs;
+      else if (ofs != first_ofs)
+        colored = true;
+    }
+  if (!colored)
+    fail ("all slabs have the same color");
+  msg ("Slabs are colored.");
+
+  ctor_before = ctor_cnt;
+  o = objs[OBJ_CNT / 2];
+  kmem_cache_free (cache, o);
+  if (kmem_cache_alloc (cache) != o || o->magic != OBJ_MAGIC
+      || ctor_cnt != ctor_before)
+    fail ("freed object did not come back constructed");
+  msg ("A freed object comes back without being constructed again.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+  msg ("Freed all objects.");
+}
+
+static void
+construct (void *o_) 
+{
+  struct object *o = o_;
+
+  o->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
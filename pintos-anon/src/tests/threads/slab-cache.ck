@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocated 200 constructed, aligned objects.
+(slab-cache) No two objects overlap.
+(slab-cache) Slabs are colored.
+(slab-cache) A freed object comes back without being constructed again.
+(slab-cache) Freed all objects.
+(slab-cache) end
+EOF
+pass;
@@ -0,0 +1,195 @@
+/* Checks memcpy(), memmove(), memset() and memcmp() against
+   byte-at-a-time references across sizes and alignments, then
+   reports the bytes per cycle that each achieves for small and
+   large blocks, aligned and misaligned, using the plain string
+   instructions and, if the CPU has them, the SSE2 routines. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+
+#define BUF_SIZE 8192
+#define REPS 64
+
+static uint8_t src_buf[BUF_SIZE + 16];
+static uint8_t dst_buf[BUF_SIZE + 16];
+static uint8_t ref_buf[BUF_SIZE + 16];
+
+static void check_all (void);
+static void bench_all (const char *mode);
+
+void
+test_string_bench (void) 
+{
+  void *(*saved_memcpy) (void *, const void *, size_t) = memcpy_hook;
+  void *(*saved_memset) (void *, int, size_t) = memset_hook;
+
+  memcpy_hook = NULL;
+  memset_hook = NULL;
+  check_all ();
+  bench_all ("rep");
+
+  if (cpu_sse2) 
+    {
+      memcpy_hook = saved_memcpy;
+      memset_hook = saved_memset;
+      check_all ();
+      bench_all ("sse2");
+    }
+
+  memcpy_hook = saved_memcpy;
+  memset_hook = saved_memset;
+  pass ();
+}
+
+/* Block sizes to check, chosen around the thresholds in
+   lib/string.c. */
+static const size_t check_sizes[] =
+  {0, 1, 3, 4, 15, 16, 17, 63, 64, 511, 512, 513, 1000, 4096};
+#define CHECK_SIZE_CNT (sizeof check_sizes / sizeof *check_sizes)
+
+/* Fills the buffers with distinct patterns. */
+static void
+fill_buffers (void) 
+{
+  size_t i;
+
+  for (i = 0; i < sizeof src_buf; i++) 
+    {
+      src_buf[i] = i * 7 + 1;
+      dst_buf[i] = ref_buf[i] = i * 13 + 5;
+    }
+}
+
+/* Fails unless DST_BUF matches REF_BUF, naming OP and its
+   arguments in the message. */
+static void
+compare_buffers (const char *op, size_t size, int dst_ofs, int src_ofs) 
+{
+  size_t i;
+
+  for (i = 0; i < sizeof dst_buf; i++)
+    if (dst_buf[i] != ref_buf[i])
+      fail ("%s of %zu bytes, dst+%d, src+%d: byte %zu is %d, not %d",
+            op, size, dst_ofs, src_ofs, i, dst_buf[i], ref_buf[i]);
+}
+
+/* Checks each operation for every size in CHECK_SIZES at every
+   combination of word alignments. */
+static void
+check_all (void) 
+{
+  size_t s, i;
+  int d, o;
+
+  for (s = 0; s < CHECK_SIZE_CNT; s++)
+    for (d = 0; d < 4; d++)
+      for (o = 0; o < 4; o++) 
+        {
+          size_t size = check_sizes[s];
+          uint8_t *dst = dst_buf + d;
+
+          /* memcpy(). */
+          fill_buffers ();
+          if (memcpy (dst, src_buf + o, size) != dst)
+            fail ("memcpy returned wrong pointer");
+          for (i = 0; i < size; i++)
+            ref_buf[d + i] = src_buf[o + i];
+          compare_buffers ("memcpy", size, d, o);
+
+          /* memset(), using the source offset as the value. */
+          fill_buffers ();
+          if (memset (dst, 0xa0 + o, size) != dst)
+            fail ("memset returned wrong pointer");
+          for (i = 0; i < size; i++)
+            ref_buf[d + i] = 0xa0 + o;
+          compare_buffers ("memset", size, d, o);
+
+          /* memmove() within one buffer, both directions. */
+          fill_buffers ();
+          if (memmove (dst + o, dst, size) != dst + o)
+            fail ("memmove returned wrong pointer");
+          for (i = size; i-- > 0; )
+            ref_buf[d + o + i] = ref_buf[d + i];
+          compare_buffers ("memmove up", size, d + o, d);
+
+          fill_buffers ();
+          memmove (dst, dst + o, size);
+          for (i = 0; i < size; i++)
+            ref_buf[d + i] = ref_buf[d + o + i];
+          compare_buffers ("memmove down", size, d, d + o);
+
+          /* memcmp(), with a difference in the last byte. */
+          fill_buffers ();
+          memcpy (dst, src_buf + o, size);
+          if (memcmp (dst, src_buf + o, size) != 0)
+            fail ("memcmp of %zu equal bytes is nonzero", size);
+          if (size > 0) 
+            {
+              dst[size - 1]++;
+              if (memcmp (dst, src_buf + o, size) <= 0
+                  && dst[size - 1] != 0)
+                fail ("memcmp of %zu bytes missed larger last byte",
+                      size);
+            }
+        }
+}
+
+/* Prints the throughput of SIZE bytes per call, REPS calls in
+   CYCLES cycles, as bytes per cycle to two decimal places. */
+static void
+report (const char *op, size_t size, const char *alignment,
+        const char *mode, uint64_t cycles) 
+{
+  uint64_t rate = (uint64_t) size * REPS * 100 / (cycles ? cycles : 1);
+
+  printf ("%s %zu %s %s: %"PRIu64".%02"PRIu64" bytes/cycle\n",
+          op, size, alignment, mode, rate / 100, rate % 100);
+}
+
+/* Times each operation at a few sizes, with the buffers
+   word-aligned and then misaligned. */
+static void
+bench_all (const char *mode) 
+{
+  static const size_t sizes[] = {64, 512, 4096};
+  size_t s;
+  int a;
+
+  fill_buffers ();
+  for (a = 0; a < 2; a++)
+    for (s = 0; s < sizeof sizes / sizeof *sizes; s++) 
+      {
+        const char *alignment = a == 0 ? "aligned" : "misaligned";
+        uint8_t *dst = dst_buf + (a == 0 ? 0 : 1);
+        uint8_t *src = src_buf + (a == 0 ? 0 : 3);
+        size_t size = sizes[s];
+        uint64_t start;
+        int i;
+
+        start = rdtsc ();
+        for (i = 0; i < REPS; i++)
+          memcpy (dst, src, size);
+        report ("memcpy", size, alignment, mode, rdtsc () - start);
+
+        start = rdtsc ();
+        for (i = 0; i < REPS; i++)
+          memset (dst, i, size);
+        report ("memset", size, alignment, mode, rdtsc () - start);
+
+        start = rdtsc ();
+        for (i = 0; i < REPS; i++)
+          memmove (dst + 8, dst, size);
+        report ("memmove", size, alignment, mode, rdtsc () - start);
+
+        memcpy (dst, src, size);
+        start = rdtsc ();
+        for (i = 0; i < REPS; i++)
+          if (memcmp (dst, src, size) != 0)
+            fail ("memcmp of copied block is nonzero");
+        report ("memcmp", size, alignment, mode, rdtsc () - start);
+      }
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(string-bench) PASS', @output);
+foreach my $op (qw (memcpy memset memmove memcmp)) {
+    fail "missing $op timings"
+      unless grep (/^$op \d+ (mis)?aligned \w+: \d+\.\d\d bytes\/cycle$/,
+		   @output);
+}
+
+pass;
@@ -0,0 +1,139 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/interrupt.h"
+
+/* CPUID leaf 1 EDX feature bits. */
+#define CPUID_FXSR (1u << 24)   /* FXSAVE/FXRSTOR, needed for SSE. */
+#define CPUID_SSE2 (1u << 26)   /* SSE2 instructions. */
+
+/* Control register bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task Switched. */
+#define CR4_OSFXSR 0x00000200   /* OS supports FXSAVE/FXRSTOR and SSE. */
+
+/* Bytes moved by each iteration of the SSE2 loops. */
+#define SSE_CHUNK 64
+
+bool cpu_sse2;
+
+static void *sse2_memcpy (void *, const void *, size_t);
+static void *sse2_memset (void *, int, size_t);
+
+/* Detects the CPU's features and installs the fastest string
+   routines it supports. */
+void
+cpu_init (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint32_t cr4;
+
+  cpuid (0, &eax, &ebx, &ecx, &edx);
+  if (eax < 1)
+    return;
+  cpuid (1, &eax, &ebx, &ecx, &edx);
+  if ((edx & (CPUID_SSE2 | CPUID_FXSR)) != (CPUID_SSE2 | CPUID_FXSR))
+    return;
+
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  cr4 |= CR4_OSFXSR;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+
+  cpu_sse2 = true;
+  memcpy_hook = sse2_memcpy;
+  memset_hook = sse2_memset;
+}
+
+/* Makes the SSE registers usable and returns the old CR0.
+
+   Pintos saves only the integer registers across context
+   switches and runs with CR0.EM set so that any floating-point
+   use traps.  The SSE2 routines therefore run with interrupts
+   off, so that nothing else can observe or clobber the XMM
+   registers, and clear CR0.EM and CR0.TS only for their
+   duration. */
+static uint32_t
+sse_begin (void)
+{
+  uint32_t cr0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0 & ~(CR0_EM | CR0_TS)));
+  return cr0;
+}
+
+/* Restores CR0 saved by sse_begin(). */
+static void
+sse_end (uint32_t cr0)
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+/* Copies SIZE bytes from SRC to DST, 64 bytes at a time through
+   the XMM registers, with aligned stores to DST. */
+static void *
+sse2_memcpy (void *dst_, const void *src_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *src = src_;
+  enum intr_level old_level;
+  size_t head;
+  uint32_t cr0;
+
+  /* The plain routines handle the unaligned head and the tail,
+     neither of which reaches STRING_HOOK_MIN bytes. */
+  head = -(uintptr_t) dst & 15;
+  memcpy (dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+
+  old_level = intr_disable ();
+  cr0 = sse_begin ();
+  for (; size >= SSE_CHUNK; dst += SSE_CHUNK, src += SSE_CHUNK,
+         size -= SSE_CHUNK)
+    asm volatile ("movdqu 0(%1), %%xmm0; movdqu 16(%1), %%xmm1; "
+                  "movdqu 32(%1), %%xmm2; movdqu 48(%1), %%xmm3; "
+                  "movdqa %%xmm0, 0(%0); movdqa %%xmm1, 16(%0); "
+                  "movdqa %%xmm2, 32(%0); movdqa %%xmm3, 48(%0)"
+                  : : "r" (dst), "r" (src) : "memory");
+  sse_end (cr0);
+  intr_set_level (old_level);
+
+  memcpy (dst, src, size);
+  return dst_;
+}
+
+/* Sets the SIZE bytes in DST to VALUE, 64 bytes at a time
+   through the XMM registers. */
+static void *
+sse2_memset (void *dst_, int value, size_t size)
+{
+  uint8_t *dst = dst_;
+  uint32_t pattern[4];
+  enum intr_level old_level;
+  size_t head;
+  uint32_t cr0;
+
+  head = -(uintptr_t) dst & 15;
+  memset (dst, value, head);
+  dst += head;
+  size -= head;
+
+  pattern[0] = pattern[1] = pattern[2] = pattern[3]
+    = (uint8_t) value * 0x01010101u;
+
+  old_level = intr_disable ();
+  cr0 = sse_begin ();
+  asm volatile ("movdqu %0, %%xmm0" : : "m" (pattern));
+  for (; size >= SSE_CHUNK; dst += SSE_CHUNK, size -= SSE_CHUNK)
+    asm volatile ("movdqa %%xmm0, 0(%0); movdqa %%xmm0, 16(%0); "
+                  "movdqa %%xmm0, 32(%0); movdqa %%xmm0, 48(%0)"
+                  : : "r" (dst) : "memory");
+  sse_end (cr0);
+  intr_set_level (old_level);
+
+  memset (dst, value, size);
+  return dst_;
+}
@@ -0,0 +1,33 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* True if the CPU supports SSE2 and cpu_init() enabled it. */
+extern bool cpu_sse2;
+
+void cpu_init (void);
+
+/* Executes CPUID with EAX set to LEAF and stores the results in
+   the four output registers.  See [IA32-v2a] "CPUID". */
+static inline void
+cpuid (uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+       uint32_t *ecx, uint32_t *edx)
+{
+  asm volatile ("cpuid"
+                : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                : "a" (leaf));
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  /* See [IA32-v2b] "RDTSC". */
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/cpu.h */
@@ -15,12 +15,14 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -34,8 +36,12 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/ramdisk.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/inode.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -94,6 +100,9 @@ main (void)
   printf ("Pintos booting with %'"PRIu32" kB RAM...\n",
           init_ram_pages * PGSIZE / 1024);
 
+  /* Pick string routines for this CPU. */
+  cpu_init ();
+
   /* Initialize memory system. */
   palloc_init (user_page_limit);
   malloc_init ();
@@ -117,12 +126,14 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  timer_init_callbacks ();
   serial_init_queue ();
   timer_calibrate ();
 
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  ramdisk_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -247,6 +258,26 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-pio"))
+        ide_dma = false;
+      else if (!strcmp (name, "-cache"))
+        cache_size = atoi (value);
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-alloc"))
+        {
+          if (value != NULL && !strcmp (value, "extent"))
+            inode_extent_alloc = true;
+          else if (value != NULL && !strcmp (value, "sector"))
+            inode_extent_alloc = false;
+          else
+            PANIC ("unknown allocation policy `%s' (use -h for help)", value);
+        }
+      else if (!strcmp (name, "-iosched"))
+        {
+          if (value == NULL || !iosched_select (value))
+            PANIC ("unknown I/O scheduler `%s' (use -h for help)", value);
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -256,10 +287,12 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
-#ifdef USERPROG
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-lockstat"))
+        lockstat_enabled = true;
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
-#endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
@@ -315,6 +348,9 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"iostat", 1, fsutil_iostat},
+      {"frag", 1, fsutil_frag},
+      {"fsbench", 1, fsutil_fsbench},
 #endif
       {NULL, 0, NULL},
     };
@@ -364,6 +400,10 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+          "  iostat             Print I/O statistics for every block device.\n"
+          "  frag               Print the extents of each file.\n"
+          "  fsbench            Benchmark sequential reads of two files\n"
+          "                     written at the same time.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -373,15 +413,23 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -pio               Transfer IDE sectors by PIO instead of DMA.\n"
+          "  -cache=N           Keep N sectors in the buffer cache (default 64).\n"
+          "  -ramdisk=KB        Create a KB-kilobyte RAM disk named ram0,\n"
+          "                     e.g. for use with -filesys=ram0 -f.\n"
+          "  -alloc=POLICY      Allocate file sectors by POLICY, `extent'\n"
+          "                     (the default) or one at a time by `sector'.\n"
+          "  -iosched=POLICY    Order disk requests by POLICY, `fifo' or\n"
+          "                     `deadline' (the default).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
-#ifdef USERPROG
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -lockstat          Print lock contention statistics at shutdown.\n"
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
-#endif
           );
   shutdown_power_off ();
 }
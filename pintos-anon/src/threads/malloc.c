@@ -5,8 +5,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -32,7 +34,21 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of the descriptors, each thread keeps a "magazine"
+   per descriptor: a small stack of free blocks that only it
+   touches, so that most malloc() and free() calls take no lock.
+   A thread refills an empty magazine from the descriptor's free
+   list, or drains a full one into it, MAGAZINE_SIZE / 2 blocks
+   at a time under a single acquisition of the descriptor's
+   lock.  Blocks in magazines count as in use as far as their
+   arenas are concerned.
+
+   A thread's set of magazines does not fit in its struct thread,
+   which shares a page with its kernel stack.  Instead, the set is
+   allocated on the thread's first small malloc() or free(),
+   directly from the smallest descriptor that holds it. */
 
 /* Descriptor. */
 struct desc
@@ -61,11 +77,19 @@ struct block
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[MALLOC_CLASS_CNT]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
+static struct desc *magazine_desc; /* Descriptor for magazine sets. */
+
+bool malloc_magazines = true;
+static struct malloc_magazine_stats magazine_stats;
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_get (struct desc *);
+static void desc_put (struct desc *, struct block *);
+static struct magazine *get_magazine (struct desc *);
+static void count (unsigned long long *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -81,7 +105,11 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      if (magazine_desc == NULL
+          && block_size >= sizeof (struct magazine) * MALLOC_CLASS_CNT)
+        magazine_desc = d;
     }
+  ASSERT (magazine_desc != NULL);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -90,6 +118,7 @@ void *
 malloc (size_t size) 
 {
   struct desc *d;
+  struct magazine *m;
   struct block *b;
   struct arena *a;
 
@@ -119,38 +148,33 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  m = get_magazine (d);
+  if (m == NULL)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
+      lock_acquire (&d->lock);
+      b = desc_get (d);
+      lock_release (&d->lock);
+      return b;
+    }
 
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
+  /* Take a block from our magazine, refilling it if empty. */
+  if (m->cnt == 0)
+    {
+      lock_acquire (&d->lock);
+      while (m->cnt < MAGAZINE_SIZE / 2)
         {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
+          b = desc_get (d);
+          if (b == NULL)
+            break;
+          m->blocks[m->cnt++] = b;
         }
+      lock_release (&d->lock);
+      count (&magazine_stats.refills);
+      if (m->cnt == 0)
+        return NULL;
     }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
-  return b;
+  count (&magazine_stats.hits);
+  return m->blocks[--m->cnt];
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -233,26 +257,28 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
+          struct magazine *m = get_magazine (d);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          if (m == NULL)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              lock_acquire (&d->lock);
+              desc_put (d, b);
+              lock_release (&d->lock);
+            }
+          else
+            {
+              /* Put the block in our magazine, draining it first
+                 if full. */
+              if (m->cnt == MAGAZINE_SIZE)
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  lock_acquire (&d->lock);
+                  while (m->cnt > MAGAZINE_SIZE / 2)
+                    desc_put (d, m->blocks[--m->cnt]);
+                  lock_release (&d->lock);
+                  count (&magazine_stats.drains);
                 }
-              palloc_free_page (a);
+              m->blocks[m->cnt++] = b;
             }
-
-          lock_release (&d->lock);
         }
       else
         {
@@ -263,6 +289,145 @@ free (void *p)
     }
 }
 
+/* Returns the current thread's magazine for descriptor D,
+   allocating the thread's set of magazines if it has none yet.
+   Returns a null pointer if magazines are turned off or the set
+   cannot be allocated, in which case the caller should use D's
+   free list directly. */
+static struct magazine *
+get_magazine (struct desc *d) 
+{
+  struct thread *cur = thread_current ();
+
+  if (!malloc_magazines)
+    return NULL;
+  if (cur->magazines == NULL) 
+    {
+      lock_acquire (&magazine_desc->lock);
+      cur->magazines = (struct magazine *) desc_get (magazine_desc);
+      lock_release (&magazine_desc->lock);
+      if (cur->magazines == NULL)
+        return NULL;
+      memset (cur->magazines, 0,
+              sizeof (struct magazine) * MALLOC_CLASS_CNT);
+    }
+  return &cur->magazines[d - descs];
+}
+
+/* Increments magazine statistic COUNTER, which threads share. */
+static void
+count (unsigned long long *counter) 
+{
+  enum intr_level old_level = intr_disable ();
+  (*counter)++;
+  intr_set_level (old_level);
+}
+
+/* Copies the magazines' hit, refill, and drain counts into
+   *STATS. */
+void
+malloc_get_magazine_stats (struct malloc_magazine_stats *stats) 
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = magazine_stats;
+  intr_set_level (old_level);
+}
+
+/* Gives the blocks in the current thread's magazines back to
+   their descriptors, then frees the magazines themselves.
+   Called by a thread as it exits. */
+void
+malloc_thread_exit (void) 
+{
+  struct thread *cur = thread_current ();
+  size_t i;
+
+  if (cur->magazines == NULL)
+    return;
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct magazine *m = &cur->magazines[i];
+      struct desc *d = &descs[i];
+
+      if (m->cnt == 0)
+        continue;
+      lock_acquire (&d->lock);
+      while (m->cnt > 0)
+        desc_put (d, m->blocks[--m->cnt]);
+      lock_release (&d->lock);
+    }
+  lock_acquire (&magazine_desc->lock);
+  desc_put (magazine_desc, (struct block *) cur->magazines);
+  lock_release (&magazine_desc->lock);
+  cur->magazines = NULL;
+}
+
+/* Removes and returns a free block from descriptor D, whose lock
+   must be held, creating a new arena if necessary.  Returns a
+   null pointer if memory is not available. */
+static struct block *
+desc_get (struct desc *d) 
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_page (0);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Adds block B to the free list of descriptor D, whose lock must
+   be held.  If B's arena is now entirely unused, frees it. */
+static void
+desc_put (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -2,12 +2,40 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+/* Number of malloc() size classes, and number of free blocks of
+   each class that a thread may keep in its magazine. */
+#define MALLOC_CLASS_CNT 7
+#define MAGAZINE_SIZE 8
+
+/* A thread's stack of free blocks of one size class. */
+struct magazine
+  {
+    unsigned cnt;                       /* Number of blocks. */
+    void *blocks[MAGAZINE_SIZE];        /* Free blocks. */
+  };
+
+/* Serve small blocks from per-thread magazines? */
+extern bool malloc_magazines;
+
+/* malloc() calls served from a magazine (hits), and trips to a
+   descriptor to refill an empty magazine or drain a full one,
+   while malloc_magazines was set. */
+struct malloc_magazine_stats
+  {
+    unsigned long long hits;
+    unsigned long long refills;
+    unsigned long long drains;
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_get_magazine_stats (struct malloc_magazine_stats *);
 
 #endif /* threads/malloc.h */
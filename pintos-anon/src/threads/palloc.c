@@ -1,14 +1,14 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +23,62 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept in blocks of 2**ORDER pages, each aligned to its size
+   relative to the pool's base, on one free list per order.  An
+   allocation takes a block of the smallest sufficient order,
+   splitting a larger one if necessary, and gives back any pages
+   beyond those requested.  Freeing a block merges it with its
+   "buddy", the other half of the block of the next larger order,
+   for as long as the buddy is free too.  Both take time
+   logarithmic in the size of the pool.
+
+   A free block's list element is stored in its first page, and
+   the pool's order_map records, for each page that starts a
+   free block, the block's order plus one (zero otherwise).  The
+   pools are touched with interrupts off, which keeps these
+   short operations atomic and lets a dying thread's page be
+   freed from the scheduler.
+
+   Each pool also keeps a reserve of up to ZERO_RESERVE pages
+   that the idle thread has zeroed, through palloc_zero_idle(),
+   so that single-page PAL_ZERO requests need not clear a page
+   on the caller's time.  The reserve is given back to the buddy
+   system when the pool runs out of memory. */
+
+/* Orders of buddy blocks, enough for pools of up to 4 GB. */
+#define ORDER_CNT 21
+
+/* Pre-zeroed pages kept per pool. */
+#define ZERO_RESERVE 32
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks by order. */
+    struct list zeroed;                 /* Reserve of zeroed pages. */
+    size_t zeroed_cnt;                  /* Pages in the reserve. */
+    uint8_t *order_map;                 /* Per page, free order + 1. */
+    size_t page_cnt;                    /* Number of pages. */
     uint8_t *base;                      /* Base of pool. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+bool palloc_prezero = true;
+static struct palloc_zero_stats zero_stats;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static size_t block_idx (const struct pool *, struct list_elem *);
+static void *take_zeroed (struct pool *);
+static bool drain_zeroed (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,17 +111,34 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  if (page_cnt == 1 && (flags & PAL_ZERO) && palloc_prezero)
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        {
+          zero_stats.hits++;
+          intr_set_level (old_level);
+
+          /* Only the reserve's list element needs clearing. */
+          memset (pages, 0, sizeof (struct list_elem));
+          return pages;
+        }
+      zero_stats.misses++;
+    }
+  page_idx = alloc_pages (pool, page_cnt);
+  while (page_idx == SIZE_MAX && drain_zeroed (pool))
+    page_idx = alloc_pages (pool, page_cnt);
+  intr_set_level (old_level);
 
-  if (page_idx != BITMAP_ERROR)
+  if (page_idx != SIZE_MAX)
     pages = pool->base + PGSIZE * page_idx;
   else
     pages = NULL;
@@ -118,6 +175,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +195,10 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
+  old_level = intr_disable ();
+  free_pages (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -153,20 +213,105 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's order_map at its base.
+     Calculate the space needed for the map
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t map_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  size_t order;
+  if (map_pages > page_cnt)
+    PANIC ("Not enough memory in %s for order map.", name);
+  page_cnt -= map_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool.  Freeing its pages takes one block
+     per set bit of PAGE_CNT, so boot time does not grow with
+     the amount of memory. */
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->order_map = base;
+  memset (p->order_map, 0, page_cnt);
+  p->page_cnt = page_cnt;
+  p->base = base + map_pages * PGSIZE;
+  free_pages (p, 0, page_cnt);
+}
+
+/* Zeroes one free page for a pool whose pre-zeroed reserve is
+   not full, and returns true, or returns false if no pool needs
+   or can spare a page.  Called by the idle thread with
+   interrupts on; the page is zeroed with them on, too. */
+bool
+palloc_zero_idle (void)
+{
+  struct pool *pools[] = { &kernel_pool, &user_pool };
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      size_t page_idx;
+      uint8_t *page;
+
+      if (!palloc_prezero || pool->zeroed_cnt >= ZERO_RESERVE)
+        continue;
+
+      old_level = intr_disable ();
+      page_idx = alloc_pages (pool, 1);
+      intr_set_level (old_level);
+      if (page_idx == SIZE_MAX)
+        continue;
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      list_push_back (&pool->zeroed, (struct list_elem *) page);
+      pool->zeroed_cnt++;
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
+}
+
+/* Copies the pre-zeroed reserve's hit and miss counts into
+   *STATS. */
+void
+palloc_get_zero_stats (struct palloc_zero_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = zero_stats;
+  intr_set_level (old_level);
+}
+
+/* Removes and returns a page from POOL's pre-zeroed reserve, or
+   returns a null pointer if the reserve is empty.  All of the
+   page but its first sizeof (struct list_elem) bytes is zero. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  if (list_empty (&pool->zeroed))
+    return NULL;
+  pool->zeroed_cnt--;
+  return list_pop_front (&pool->zeroed);
+}
+
+/* Gives POOL's pre-zeroed reserve back to its buddy system.
+   Returns false if the reserve was already empty. */
+static bool
+drain_zeroed (struct pool *pool)
+{
+  if (list_empty (&pool->zeroed))
+    return false;
+  while (!list_empty (&pool->zeroed))
+    {
+      struct list_elem *e = list_pop_front (&pool->zeroed);
+      free_pages (pool, block_idx (pool, e), 1);
+    }
+  pool->zeroed_cnt = 0;
+  return true;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +321,101 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the list element stored in the first page of the free
+   block starting at page PAGE_IDX of POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the page in POOL that holds ELEM. */
+static size_t
+block_idx (const struct pool *pool, struct list_elem *elem)
+{
+  return ((uint8_t *) elem - pool->base) / PGSIZE;
+}
+
+/* Adds the block of 2**ORDER pages at PAGE_IDX to POOL's free
+   lists, merging it with its buddy as long as that is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, size_t order)
+{
+  ASSERT (pool->order_map[page_idx] == 0);
+
+  for (; order + 1 < ORDER_CNT; order++)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->order_map[buddy] != order + 1)
+        break;
+
+      list_remove (block_elem (pool, buddy));
+      pool->order_map[buddy] = 0;
+      if (buddy < page_idx)
+        page_idx = buddy;
+    }
+
+  pool->order_map[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, as the largest
+   blocks that their alignment allows. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      size_t order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or SIZE_MAX if no free block is large
+   enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt)
+{
+  size_t want, order, page_idx;
+
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want + 1 >= ORDER_CNT)
+      return SIZE_MAX;
+
+  for (order = want; list_empty (&pool->free_lists[order]); order++)
+    if (order + 1 >= ORDER_CNT)
+      return SIZE_MAX;
+
+  page_idx = block_idx (pool, list_pop_front (&pool->free_lists[order]));
+  pool->order_map[page_idx] = 0;
+
+  /* Split down to the order wanted, freeing upper halves. */
+  while (order > want)
+    {
+      size_t half;
+
+      order--;
+      half = page_idx + ((size_t) 1 << order);
+      pool->order_map[half] = order + 1;
+      list_push_front (&pool->free_lists[order], block_elem (pool, half));
+    }
+
+  /* Give back the pages beyond PAGE_CNT. */
+  free_pages (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
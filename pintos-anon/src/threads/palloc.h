@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -17,4 +18,20 @@ void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
 
+/* Serve single-page PAL_ZERO requests from pages zeroed by the
+   idle thread? */
+extern bool palloc_prezero;
+
+/* Single-page PAL_ZERO requests that were served from the
+   pre-zeroed reserve (hits) and that had to be zeroed on the
+   spot (misses), while palloc_prezero was set. */
+struct palloc_zero_stats
+  {
+    unsigned long long hits;
+    unsigned long long misses;
+  };
+
+bool palloc_zero_idle (void);
+void palloc_get_zero_stats (struct palloc_zero_stats *);
+
 #endif /* threads/palloc.h */
@@ -0,0 +1,323 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   A cache hands out objects of a single type.  Its memory comes
+   from the page allocator one page, called a "slab", at a time.
+   Each slab starts with a header, followed by an array that
+   links the slab's free objects by index, followed by as many
+   objects of exactly the cache's size as fit.  Unlike malloc(),
+   which rounds each request up to a power of 2, a cache thus
+   wastes only the tail of each page.
+
+   The objects of a new slab are run through the cache's
+   constructor, if it has one.  Objects are expected to be in
+   their constructed state again when they are freed, so keeping
+   the free list outside the objects lets a cache hand out
+   constructed objects without running the constructor again.
+
+   A cache keeps its slabs on three lists: full, partially full
+   and empty.  Objects are allocated from partially full slabs
+   first, so that as few slabs as possible are in use, and all
+   but KMEM_EMPTY_MAX empty slabs are given back to the page
+   allocator.
+
+   The unused tail of a page is used to "color" slabs: the
+   objects of successive slabs start at different multiples of
+   the cache line size, so that objects at the same index in
+   different slabs do not compete for the same cache lines. */
+
+/* Empty slabs kept by each cache. */
+#define KMEM_EMPTY_MAX 1
+
+/* Step between slab colors, in bytes. */
+#define CACHE_LINE 64
+
+/* Free list index marking the end of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name (for debugging purposes). */
+    size_t obj_size;            /* Object size, a multiple of ALIGN. */
+    size_t align;               /* Object alignment. */
+    kmem_ctor *ctor;            /* Constructor, or NULL. */
+    size_t obj_cnt;             /* Objects per slab. */
+    size_t obj_ofs;             /* Offset of an uncolored slab's objects. */
+    size_t color_step;          /* Step between colors. */
+    size_t color_max;           /* Largest color. */
+    size_t color_next;          /* Color of the next new slab. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct list full;           /* Slabs with no free object. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct list empty;          /* Slabs with all objects free. */
+    size_t empty_cnt;           /* Number of slabs on EMPTY. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t in_use;              /* Objects allocated. */
+
+    struct list_elem elem;      /* Element in all_caches. */
+  };
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of CACHE's lists. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Objects allocated. */
+    uint16_t free;              /* First free object, or SLAB_END. */
+    uint16_t next[];            /* Per free object, the next one. */
+  };
+
+/* All caches, for kmem_print_stats(). */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Returns the offset in a slab of the first of CNT objects
+   aligned to ALIGN. */
+static size_t
+objs_ofs (size_t cnt, size_t align)
+{
+  return ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t), align);
+}
+
+/* Creates and returns a cache, named NAME for debugging
+   purposes, of objects of SIZE bytes aligned to ALIGN bytes, a
+   power of 2 (or 0 for the default).  If CTOR is non-null, it is
+   run on each object when its slab is created.  Returns a null
+   pointer if memory is not available.
+
+   SIZE must be small enough that a page holds at least a few
+   objects; malloc() handles larger blocks as well as a cache
+   would. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+  size_t leftover;
+
+  if (align < sizeof (void *))
+    align = sizeof (void *);
+  ASSERT (align <= PGSIZE / 8 && (align & (align - 1)) == 0);
+  ASSERT (size > 0 && size <= PGSIZE / 4);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, align);
+  c->align = align;
+  c->ctor = ctor;
+
+  /* Fit as many objects as possible, with their free list. */
+  c->obj_cnt = (PGSIZE - sizeof (struct slab))
+               / (c->obj_size + sizeof (uint16_t));
+  while (objs_ofs (c->obj_cnt, align) + c->obj_cnt * c->obj_size > PGSIZE)
+    c->obj_cnt--;
+  ASSERT (c->obj_cnt > 0 && c->obj_cnt < SLAB_END);
+  c->obj_ofs = objs_ofs (c->obj_cnt, align);
+
+  /* Color with whatever is left over. */
+  leftover = PGSIZE - c->obj_ofs - c->obj_cnt * c->obj_size;
+  c->color_step = align > CACHE_LINE ? align : CACHE_LINE;
+  c->color_max = leftover / c->color_step * c->color_step;
+  c->color_next = 0;
+
+  lock_init (&c->lock);
+  list_init (&c->full);
+  list_init (&c->partial);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->in_use = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->elem);
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Allocates and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t idx;
+
+  ASSERT (c != NULL);
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty))
+    {
+      s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      c->empty_cnt--;
+      list_push_front (&c->partial, &s->elem);
+    }
+  else
+    {
+      s = new_slab (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take the slab's first free object. */
+  idx = s->free;
+  ASSERT (idx != SLAB_END);
+  s->free = s->next[idx];
+  c->in_use++;
+  if (++s->in_use == c->obj_cnt)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  lock_release (&c->lock);
+
+  return s->objs + idx * c->obj_size;
+}
+
+/* Frees OBJ, which must have been allocated from cache C and, if
+   C has a constructor, must be back in its constructed state. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it must stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->in_use > 0);
+  s->next[idx] = s->free;
+  s->free = idx;
+  c->in_use--;
+  if (s->in_use-- == c->obj_cnt)
+    {
+      /* Was full. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < KMEM_EMPTY_MAX)
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        {
+          s->magic = 0;
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints the number of objects and slabs of each cache. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab %s: %zu-byte objects, %zu per slab, "
+              "%zu in use, %zu slabs\n",
+              c->name, c->obj_size, c->obj_cnt, c->in_use, c->slab_cnt);
+    }
+}
+
+/* Creates a slab for cache C, whose lock must be held, and
+   constructs its objects.  Returns a null pointer if memory is
+   not available. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = (uint8_t *) s + c->obj_ofs + c->color_next;
+  s->in_use = 0;
+  s->free = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+
+  c->color_next += c->color_step;
+  if (c->color_next > c->color_max)
+    c->color_next = 0;
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab of cache C that holds OBJ. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+
+  return s;
+}
@@ -27,12 +27,130 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 
-extern struct list ready_list;
+static bool wake_waiter (struct wait_queue *);
+static bool sema_wake (struct semaphore *);
+static bool lock_drop (struct lock *);
+static void lock_init_at (struct lock *, const void *callsite);
+static void lockstat_acquired (struct lock *, bool contended,
+                               int64_t wait_start);
+
+/* Priority wait queues.
+
+   Waiters are grouped into buckets, one for each priority that
+   has a waiter, and QUEUE->buckets holds the buckets in
+   descending order of priority.  The first thread to arrive at a
+   priority stands for its bucket: its elem is linked into
+   QUEUE->buckets and the threads arriving after it at the same
+   priority wait, in FIFO order, on its wait_bucket list.
+
+   Waking the highest priority waiter thus takes constant time,
+   and queueing a thread visits at most one bucket per distinct
+   waiting priority, however many threads are waiting.  A waiter
+   whose priority changes is moved to its new bucket by
+   thread_change_priority().
+
+   All of these functions must be called with interrupts off. */
+
+/* Initializes QUEUE as an empty wait queue. */
+void
+wait_queue_init (struct wait_queue *queue)
+{
+  list_init (&queue->buckets);
+}
+
+/* Returns true if no thread is waiting in QUEUE. */
+bool
+wait_queue_empty (struct wait_queue *queue)
+{
+  return list_empty (&queue->buckets);
+}
+
+/* Returns the priority of the highest priority thread in QUEUE,
+   or PRI_MIN - 1 if QUEUE is empty. */
+int
+wait_queue_priority (struct wait_queue *queue)
+{
+  if (list_empty (&queue->buckets))
+    return PRI_MIN - 1;
+  return list_entry (list_front (&queue->buckets),
+                     struct thread, elem)->priority;
+}
+
+/* Adds T at the back of QUEUE's bucket for T's priority. */
+void
+wait_queue_push (struct wait_queue *queue, struct thread *t)
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->wait_queue == NULL);
+
+  t->wait_queue = queue;
+  for (e = list_begin (&queue->buckets); e != list_end (&queue->buckets);
+       e = list_next (e))
+    {
+      struct thread *head = list_entry (e, struct thread, elem);
+
+      if (head->priority == t->priority)
+        {
+          t->wait_head = false;
+          list_push_back (&head->wait_bucket, &t->elem);
+          return;
+        }
+      if (head->priority < t->priority)
+        break;
+    }
+
+  /* first waiter at this priority: start a bucket before E */
+  t->wait_head = true;
+  list_init (&t->wait_bucket);
+  list_insert (e, &t->elem);
+}
+
+/* Removes T from the wait queue it is waiting in.  If T stands
+   for its bucket, the next thread of the bucket takes its
+   place. */
+void
+wait_queue_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->wait_queue != NULL);
+
+  if (t->wait_head && !list_empty (&t->wait_bucket))
+    {
+      struct thread *next = list_entry (list_pop_front (&t->wait_bucket),
+                                        struct thread, elem);
+      next->wait_head = true;
+      list_init (&next->wait_bucket);
+      list_splice (list_end (&next->wait_bucket),
+                   list_begin (&t->wait_bucket), list_end (&t->wait_bucket));
+      list_insert (&t->elem, &next->elem);
+    }
+  list_remove (&t->elem);
+  t->wait_queue = NULL;
+}
+
+/* Removes and returns the highest priority thread in QUEUE, which
+   must not be empty.  Among threads of equal priority, the one
+   that has waited longest is chosen. */
+struct thread *
+wait_queue_pop (struct wait_queue *queue)
+{
+  struct thread *t;
+
+  ASSERT (!wait_queue_empty (queue));
+
+  t = list_entry (list_front (&queue->buckets), struct thread, elem);
+  wait_queue_remove (t);
+  return t;
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -49,7 +167,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  wait_queue_init (&sema->waiters);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -70,8 +188,7 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_insert_ordered(&sema->waiters,&thread_current ()->elem,
-        thread_priority_large_func,NULL);
+      wait_queue_push (&sema->waiters, thread_current ());
       thread_block ();
     }
   sema->value--;
@@ -106,30 +223,53 @@ sema_try_down (struct semaphore *sema)
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
+   If the thread woken outranks the running thread, yields to it,
+   or, within an interrupt handler, as the handler returns.
 
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) 
 {
   enum intr_level old_level;
-  bool yield_if_necessary = false;
+  bool yield_if_necessary;
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)){
-    struct thread *next = list_entry
-      (list_pop_front (&sema->waiters), struct thread, elem);
-    
-    if(next->priority > thread_current()->priority){
-      yield_if_necessary = true;     
+  yield_if_necessary = sema_wake (sema);
+  intr_set_level (old_level);
+  if (yield_if_necessary)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
     }
-      
-    thread_unblock (next);
-  } 
-    
+}
+
+/* Wakes the highest priority thread in QUEUE, which must not be
+   empty, and returns true if it outranks the running thread. */
+static bool
+wake_waiter (struct wait_queue *queue)
+{
+  struct thread *next = wait_queue_pop (queue);
+
+  /* unblock first: under MLFQS it refreshes a stale priority */
+  thread_unblock (next);
+  return next->priority > thread_current ()->priority;
+}
+
+/* Increments SEMA's value and wakes its highest priority waiter,
+   if any, without yielding.  Returns true if the woken thread
+   outranks the running thread.  Interrupts must be off. */
+static bool
+sema_wake (struct semaphore *sema)
+{
+  bool outranks = false;
+
+  if (!wait_queue_empty (&sema->waiters))
+    outranks = wake_waiter (&sema->waiters);
   sema->value++;
-  intr_set_level (old_level);
-  if(yield_if_necessary && !intr_context()) thread_yield();
+  return outranks;
 }
 
 static void sema_test_helper (void *sema_);
@@ -169,6 +309,52 @@ sema_test_helper (void *sema_)
     }
 }
 
+/* Lock statistics, one entry per lock_init() call site, hashed
+   by call site with linear probing. */
+#define LOCKSTAT_CNT 128                /* Call sites tracked. */
+#define LOCKSTAT_TOP 10                 /* Call sites printed. */
+bool lockstat_enabled;
+static struct lock_stats lockstat_table[LOCKSTAT_CNT];
+static size_t lockstat_used;            /* Entries in use. */
+static size_t lockstat_dropped;         /* Locks left out when full. */
+
+/* Returns the statistics for locks initialized at CALLSITE,
+   creating them if necessary, or NULL if the table is full. */
+static struct lock_stats *
+lockstat_lookup (const void *callsite)
+{
+  struct lock_stats *stats = NULL;
+  enum intr_level old_level;
+  size_t i;
+
+  old_level = intr_disable ();
+  i = ((uintptr_t) callsite >> 2) % LOCKSTAT_CNT;
+  for (;;)
+    {
+      struct lock_stats *e = &lockstat_table[i];
+      if (e->callsite == callsite)
+        {
+          stats = e;
+          break;
+        }
+      if (e->callsite == NULL)
+        {
+          if (lockstat_used < LOCKSTAT_CNT - 1)
+            {
+              e->callsite = callsite;
+              lockstat_used++;
+              stats = e;
+            }
+          else
+            lockstat_dropped++;
+          break;
+        }
+      i = (i + 1) % LOCKSTAT_CNT;
+    }
+  intr_set_level (old_level);
+  return stats;
+}
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -186,17 +372,32 @@ sema_test_helper (void *sema_)
    instead of a lock. */
 void
 lock_init (struct lock *lock)
+{
+  lock_init_at (lock, __builtin_return_address (0));
+}
+
+/* Initializes LOCK, attributing its statistics to CALLSITE. */
+static void
+lock_init_at (struct lock *lock, const void *callsite)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->stats = NULL;
+  if (lockstat_enabled)
+    lock->stats = lockstat_lookup (callsite);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   If LOCK is held, the current thread donates its priority to
+   the holder, and on along the chain of threads that are each
+   waiting for a lock held by the next, up to DONATION_DEPTH
+   links.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -210,46 +411,37 @@ lock_acquire (struct lock *lock)
 
   enum intr_level old_level= intr_disable ();
   struct thread *cur = thread_current ();
-
-  struct semaphore *sema = &lock->semaphore;
-
-  /* Loop for nested donation;
-    We can conclude that in no circumstances a lower priority 
-    thread can run before higher so that when nested donation 
-    happens, we always ensure the lowest get the highest donation */
-  while (sema->value == 0){
-    /* equal priority is not needed to donate;
-      Ensure when a medium thread get donation and wake up, 
-      it donate to the lower thread */
-    if(lock->holder->priority < cur->priority){
-      lock->holder->stored_priority[lock->holder->stored_index] =
-         lock->holder->priority;
-      lock->holder->stored_lock_master[lock->holder->stored_index++] = 
-        lock->holder->priority_lock_master;
-
-      lock->holder->priority = cur->priority;
-      lock->holder->priority_lock_master = lock;
-
-        /* remove lock holder from ready list 
-          and add again to ready list to adjust its priority;
-          A little faster than list_sort */
-      list_remove(&lock->holder->elem);
-      list_insert_ordered(&ready_list,&lock->holder->elem,
-        thread_priority_large_func,NULL);
+  bool contended = lock->holder != NULL;
+  int64_t wait_start = lock->stats != NULL ? timer_ticks () : 0;
+
+  if (lock->holder != NULL){
+    cur->waiting_lock = lock;
+    if (!thread_mlfqs){
+      struct lock *l = lock;
+      int depth;
+
+      /* equal priority is not needed to donate, and a holder
+        that already runs at our priority has passed it on */
+      for (depth = 0; depth < DONATION_DEPTH && l != NULL 
+                      && l->holder != NULL; depth++){
+        struct thread *holder = l->holder;
+        if (holder->priority >= cur->priority)
+          break;
+        thread_change_priority (holder, cur->priority);
+        l = holder->waiting_lock;
+      }
     }
-      /* add current thread to lock's wait list */
-    list_insert_ordered(&lock->semaphore.waiters,&cur->elem,
-      thread_priority_large_func,NULL);
-    
-    thread_block();
-    /* after this block, scheduler should run the lock holder;
-      if nested donation happens, the thread will loop to 
-      donate the lower one*/
   }
-  /* sema_down will add the thread to the wait list;
-     we have to manully decrease it here */
-  sema->value--;
-  lock->holder = thread_current ();
+
+  sema_down (&lock->semaphore);
+
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+  if (lock->stats != NULL)
+    lockstat_acquired (lock, contended, wait_start);
+  /* threads still waiting for LOCK now donate to us */
+  thread_refresh_priority (cur);
 
   intr_set_level (old_level);
 }
@@ -263,18 +455,28 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+      if (lock->stats != NULL)
+        lockstat_acquired (lock, false, 0);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   Priority donated through LOCK is given back, which takes time
+   proportional to the number of locks the thread still holds.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -286,51 +488,27 @@ lock_release (struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   enum intr_level old_level = intr_disable ();
 
+  /* yield to the woken waiter if it now outranks us */
+  if (lock_drop (lock))
+    thread_yield ();
+
+  intr_set_level (old_level);
+}
+
+/* Releases LOCK and wakes its highest priority waiter without
+   yielding.  Returns true if the waiter outranks the running
+   thread.  Interrupts must be off. */
+static bool
+lock_drop (struct lock *lock)
+{
   struct thread *cur = thread_current ();
 
-  /* unblock the highest priority thread 
-    and give out all the priority get from this lock(include current) */
-  if(cur->stored_index != 0){
-    /* first check every priority donation and remove this lock's */
-    int co = 0;
-    for(int i=0;i<cur->stored_index;i++){
-      if(cur->stored_lock_master[i]==lock){
-        cur->stored_lock_master[i]=NULL;
-        cur->stored_priority[i]=-1;
-        co++;
-      }
-    }
-    /* resize the array since some donations are removed */
-    if(co!=0){
-      for(int i=0;i<cur->stored_index;i++){
-        if(cur->stored_priority[i]==-1){
-          for(int j=i+1;j<cur->stored_index;j++){
-            if(cur->stored_priority[j]==-1)continue;
-            cur->stored_lock_master[i]=cur->stored_lock_master[j];
-            cur->stored_priority[i]=cur->stored_priority[j];
-            cur->stored_lock_master[j]=NULL;
-            cur->stored_priority[j]=-1;
-            break;
-          }
-        }
-      }
-      cur->stored_index-=co;
-    }
-    
-    /* remove the holding priority if it comes from this lock;
-      get the second highest priority from stored_priority */
-    if(cur->priority_lock_master == lock){
-      cur->stored_index--;
-      cur->priority = cur->stored_priority[cur->stored_index];
-      cur->priority_lock_master = cur->stored_lock_master[cur->stored_index];
-    }
-    
-  }
+  if (lock->stats != NULL)
+    lock->stats->hold_ticks += timer_ticks () - lock->acquire_tick;
+  list_remove (&lock->elem);
   lock->holder = NULL;
-  sema_up (&lock->semaphore);
-
-  intr_set_level (old_level);
-  /* give up cpu to let scheduler decide next */
+  thread_refresh_priority (cur);
+  return sema_wake (&lock->semaphore);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -343,33 +521,92 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
-
-/* One semaphore in a list. */
-struct semaphore_elem 
-  {
-    struct list_elem elem;              /* List element. */
-    struct semaphore semaphore;         /* This semaphore. */
-  };
-
-/* Here the function is funky, it should not be used to list_insert_ordered
-  since list elements to inserted is not in waiters list;
-  I am not sure if it runs faster with insertion so I decide to use list_sort
-  so that this function will be elegant;
-    If using insertion: thread *ta = thread_current(); */
-bool cond_thread_priority_large_func(const struct list_elem *a, 
-  const struct list_elem *b, void *aux)
-{
-  struct semaphore *sa = &list_entry (a, struct semaphore_elem,
-                                      elem)->semaphore;
-  struct semaphore *sb = &list_entry (b, struct semaphore_elem, 
-                                      elem)->semaphore;
-  struct thread *ta = list_entry(list_front(&sa->waiters), 
-                                struct thread, elem);
-  struct thread *tb = list_entry(list_front(&sb->waiters),
-                                struct thread, elem);
-  return ta->priority > tb->priority;
+
+/* Names the call site that initialized LOCK, for lockstat_print().
+   Does nothing if LOCK's statistics are not kept. */
+void
+lock_set_name (struct lock *lock, const char *name)
+{
+  ASSERT (lock != NULL);
+
+  if (lock->stats != NULL)
+    lock->stats->name = name;
 }
 
+/* Records that the current thread acquired LOCK, after waiting
+   since WAIT_START if CONTENDED.  Interrupts must be off. */
+static void
+lockstat_acquired (struct lock *lock, bool contended, int64_t wait_start)
+{
+  struct lock_stats *stats = lock->stats;
+
+  lock->acquire_tick = timer_ticks ();
+  stats->acquired++;
+  if (contended)
+    {
+      int64_t wait = lock->acquire_tick - wait_start;
+
+      stats->contended++;
+      stats->wait_ticks += wait;
+      if (wait > stats->max_wait_ticks)
+        stats->max_wait_ticks = wait;
+    }
+}
+
+/* Returns true if lock call site A has been more contended than
+   B. */
+static bool
+lockstat_hotter (const struct lock_stats *a, const struct lock_stats *b)
+{
+  if (a->contended != b->contended)
+    return a->contended > b->contended;
+  if (a->wait_ticks != b->wait_ticks)
+    return a->wait_ticks > b->wait_ticks;
+  return a->acquired > b->acquired;
+}
+
+/* Prints the statistics of the LOCKSTAT_TOP most contended lock
+   call sites, if lock statistics are kept. */
+void
+lockstat_print (void)
+{
+  bool printed[LOCKSTAT_CNT];
+  size_t i, n;
+
+  if (!lockstat_enabled)
+    return;
+
+  printf ("Lockstat: %zu call sites", lockstat_used);
+  if (lockstat_dropped > 0)
+    printf (", %zu locks not tracked", lockstat_dropped);
+  printf ("\n");
+
+  memset (printed, 0, sizeof printed);
+  for (n = 0; n < LOCKSTAT_TOP && n < lockstat_used; n++)
+    {
+      struct lock_stats *top = NULL;
+      size_t top_idx = 0;
+
+      for (i = 0; i < LOCKSTAT_CNT; i++)
+        if (lockstat_table[i].callsite != NULL && !printed[i]
+            && (top == NULL || lockstat_hotter (&lockstat_table[i], top)))
+          {
+            top = &lockstat_table[i];
+            top_idx = i;
+          }
+      printed[top_idx] = true;
+
+      if (top->name != NULL)
+        printf ("  %-16s", top->name);
+      else
+        printf ("  %-16p", top->callsite);
+      printf (" %llu acquired, %llu contended, %"PRId64" wait ticks "
+              "(max %"PRId64"), %"PRId64" hold ticks\n",
+              top->acquired, top->contended, top->wait_ticks,
+              top->max_wait_ticks, top->hold_ticks);
+    }
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -378,7 +615,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  wait_queue_init (&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -404,18 +641,21 @@ cond_init (struct condition *cond)
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
-  struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
-  
-  sema_init (&waiter.semaphore, 0);
 
-  list_push_front (&cond->waiters,&waiter.elem);
-  lock_release (lock);
-  sema_down (&waiter.semaphore);
+  /* queue ourselves and release LOCK atomically; we block right
+    away, so a waiter woken by the release need not be yielded to */
+  old_level = intr_disable ();
+  wait_queue_push (&cond->waiters, thread_current ());
+  lock_drop (lock);
+  thread_block ();
+  intr_set_level (old_level);
+
   lock_acquire (lock);
 }
 
@@ -434,11 +674,14 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)){
-    list_sort(&cond->waiters,cond_thread_priority_large_func,NULL);
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-      struct semaphore_elem, elem)->semaphore);
-  }
+  enum intr_level old_level = intr_disable ();
+  bool yield_if_necessary = false;
+
+  if (!wait_queue_empty (&cond->waiters))
+    yield_if_necessary = wake_waiter (&cond->waiters);
+  intr_set_level (old_level);
+  if (yield_if_necessary)
+    thread_yield ();
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -453,6 +696,212 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!wait_queue_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a readers-writer lock.  Any number of
+   threads may hold RW for reading at once, or a single thread
+   may hold it for writing.
+
+   The writer holds RW->lock for as long as it writes, including
+   while it waits for the readers present when it arrived to
+   leave.  Readers only pass through RW->lock on their way in.
+   Thus a waiting writer keeps readers that arrive after it out,
+   so that a stream of readers cannot starve writers, and every
+   thread blocked on RW donates its priority to the writer as it
+   would to the holder of a lock.  Readers are not tracked
+   individually, so a writer waiting for readers to leave does
+   not donate to them. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init_at (&rw->lock, __builtin_return_address (0));
+  rw->readers = 0;
+  rw->writing = false;
+  rw->draining = false;
+  sema_init (&rw->drained, 0);
+}
+
+/* Adds the current thread to RW's readers.  RW->lock must be
+   held, which keeps writers out. */
+static void
+add_reader (struct rwlock *rw)
+{
+  enum intr_level old_level = intr_disable ();
+  rw->readers++;
+  intr_set_level (old_level);
+}
+
+/* Waits until RW has no readers.  RW->lock must be held, which
+   keeps new readers from arriving meanwhile. */
+static void
+wait_for_readers (struct rwlock *rw)
+{
+  enum intr_level old_level = intr_disable ();
+  while (rw->readers > 0)
+    {
+      rw->draining = true;
+      sema_down (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.  The current thread must not already hold
+   RW for writing.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  add_reader (rw);
+  lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for reading without sleeping and returns
+   true if successful or false if a writer holds or awaits it. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+  add_reader (rw);
+  lock_release (&rw->lock);
+  return true;
+}
+
+/* Releases RW, which the current thread holds for reading.  The
+   last reader to leave lets a waiting writer in.
+
+   This function may be called with interrupts disabled. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0 && rw->draining)
+    {
+      rw->draining = false;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  wait_for_readers (rw);
+  rw->writing = true;
+}
+
+/* Tries to acquire RW for writing without sleeping and returns
+   true if successful or false if any other thread holds it. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+  if (rw->readers > 0)
+    {
+      lock_release (&rw->lock);
+      return false;
+    }
+  rw->writing = true;
+  return true;
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rwlock_held_for_write (rw));
+
+  rw->writing = false;
+  lock_release (&rw->lock);
+}
+
+/* Tries to turn the current thread's hold on RW for reading into
+   one for writing, without sleeping.  Succeeds only if the
+   current thread is RW's only reader and RW->lock is free.  It
+   fails, and returns false, if another thread also holds RW for
+   reading, or holds or awaits it for writing, or is on its way in
+   to read.  The current thread then still holds RW for reading;
+   to write, it must release RW and acquire it for writing, after
+   which whatever it read may be stale. */
+bool
+rwlock_try_upgrade (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+
+  /* New readers pass through RW->lock, so once we hold it the
+     count can only go down. */
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  success = rw->readers == 1;
+  if (success)
+    {
+      rw->readers = 0;
+      rw->writing = true;
+    }
+  intr_set_level (old_level);
+
+  if (!success)
+    lock_release (&rw->lock);
+  return success;
+}
+
+/* Turns the current thread's hold on RW for writing into one for
+   reading.  No other thread can write between the current
+   thread's write and its read: a writer that RW->lock passes to
+   next still waits for the current thread to leave.  Threads
+   waiting for RW are let in in the order RW->lock passes to
+   them, so readers queued behind a writer keep waiting until
+   that writer is done. */
+void
+rwlock_downgrade (struct rwlock *rw)
+{
+  ASSERT (rwlock_held_for_write (rw));
+
+  add_reader (rw);
+  rw->writing = false;
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writing && lock_held_by_current_thread (&rw->lock);
+}
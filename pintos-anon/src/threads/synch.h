@@ -3,12 +3,29 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Threads waiting on a synchronization primitive, woken in order
+   of priority and first-come first-served within a priority. */
+struct wait_queue
+  {
+    struct list buckets;        /* One thread per waiting priority. */
+  };
+
+void wait_queue_init (struct wait_queue *);
+bool wait_queue_empty (struct wait_queue *);
+int wait_queue_priority (struct wait_queue *);
+void wait_queue_push (struct wait_queue *, struct thread *);
+struct thread *wait_queue_pop (struct wait_queue *);
+void wait_queue_remove (struct thread *);
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct wait_queue waiters;  /* Waiting threads. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -17,23 +34,50 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Contention statistics, shared by all the locks initialized
+   at one call site.  Kept only if lockstat_enabled is set when
+   the locks are initialized. */
+struct lock_stats
+  {
+    const void *callsite;       /* Return address of lock_init(). */
+    const char *name;           /* Set by lock_set_name(), or NULL. */
+    unsigned long long acquired;        /* Acquisitions. */
+    unsigned long long contended;       /* Acquisitions that waited. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    int64_t max_wait_ticks;     /* Longest single wait. */
+    int64_t hold_ticks;         /* Total ticks held. */
+  };
+
+/* Keep lock statistics?  Set by the kernel command-line
+   option "-lockstat". */
+extern bool lockstat_enabled;
+
 /* Lock. */
 struct lock 
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
+    struct lock_stats *stats;   /* Statistics, or NULL if not kept. */
+    int64_t acquire_tick;       /* When last acquired, for stats. */
   };
 
+/* Maximum number of links of a wait-for chain that a priority
+   donation is passed along. */
+#define DONATION_DEPTH 8
+
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_set_name (struct lock *, const char *name);
+void lockstat_print (void);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct wait_queue waiters;  /* Waiting threads. */
   };
 
 void cond_init (struct condition *);
@@ -41,6 +85,27 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Held by the writer; readers pass it. */
+    unsigned readers;           /* Number of threads reading. */
+    bool writing;               /* Held for writing? */
+    bool draining;              /* Writer waiting for readers to leave? */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_try_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
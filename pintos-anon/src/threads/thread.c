@@ -24,9 +24,18 @@
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO
+   queue per priority; bit P of ready_mask is set iff
+   ready_queues[P] is nonempty, so the highest ready priority is
+   a single bit scan. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+#if PRI_CNT > 64
+#error ready_mask requires at most 64 priority levels
+#endif
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_mask;
+static size_t ready_cnt;        /* # of threads in all ready queues. */
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -40,6 +49,13 @@ static struct lock tid_lock;
 /* load average to advance scheduler */
 static fixed_point load_avg;
 
+/* Seconds of recent_cpu decay coefficients kept so that blocked
+   threads can catch up lazily; see recent_cpu_catch_up(). */
+#define DECAY_HISTORY 16
+static fixed_point decay_coef[DECAY_HISTORY];
+static int64_t mlfqs_seconds;   /* # of per-second MLFQS updates. */
+static size_t mlfqs_max_work;   /* Most threads visited by one update. */
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -73,6 +89,11 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_highest (void);
+static int mlfqs_priority (struct thread *);
+static bool recent_cpu_catch_up (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -90,10 +111,15 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_mask = 0;
+  ready_cnt = 0;
   list_init (&all_list);
   load_avg = INT_TO_FP(0);
 
@@ -143,6 +169,15 @@ thread_tick (void)
     intr_yield_on_return ();
 }
 
+/* Accounts for CNT timer ticks that passed in the idle thread
+   without a timer interrupt, because of tickless idle. */
+void
+thread_tick_idle (int64_t cnt)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  idle_ticks += cnt;
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
@@ -245,9 +280,10 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered (&ready_list, &t->elem, 
-                      thread_priority_large_func, NULL);
+  if (thread_mlfqs && t != idle_thread && recent_cpu_catch_up (t))
+    t->priority = mlfqs_priority (t);
   t->status = THREAD_READY;
+  ready_queue_push (t);
   intr_set_level (old_level);
 }
 
@@ -294,6 +330,7 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  malloc_thread_exit ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -316,10 +353,9 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_insert_ordered (&ready_list, &cur->elem, 
-                        thread_priority_large_func, NULL);
   cur->status = THREAD_READY;
+  if (cur != idle_thread) 
+    ready_queue_push (cur);
   schedule ();
   intr_set_level (old_level);
 }
@@ -341,7 +377,8 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY.  Priority
+   donated to the thread still applies on top of it. */
 void
 thread_set_priority (int new_priority) 
 {
@@ -349,18 +386,14 @@ thread_set_priority (int new_priority)
   enum intr_level old_level=intr_disable ();
 
   struct thread *cur = thread_current ();
-  bool yield_if_necessary = false;
-
-  /* if current priority gets from donation, we should not change it */
-  if(cur->stored_index != 0){
-    cur->stored_priority[0] = new_priority;
-  }else{
-    cur->priority=new_priority;
-    yield_if_necessary = true;
-  }
-  
+  cur->base_priority = new_priority;
+  thread_refresh_priority (cur);
+  bool outranked = ready_queue_highest () > cur->priority;
+
   intr_set_level (old_level);
-  if(yield_if_necessary) thread_yield();  
+  /* yield if the priority is not highest */
+  if (outranked)
+    thread_yield ();
 }
 
 /* Returns the current thread's priority. */
@@ -370,57 +403,220 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
+/* Sets T's priority to PRIORITY.  If T is ready to run, it is
+   moved to the tail of the ready queue for its new priority;
+   likewise if T is waiting in a wait queue (see synch.c).
+   This function must be called with interrupts off. */
+void
+thread_change_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->priority == priority)
+    return;
+  if (t->status == THREAD_READY)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else if (t->wait_queue != NULL)
+    {
+      /* move to the bucket of the new priority */
+      struct wait_queue *queue = t->wait_queue;
+      wait_queue_remove (t);
+      t->priority = priority;
+      wait_queue_push (queue, t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Recomputes T's effective priority as the highest of its base
+   priority and the priority of the first waiter of each lock it
+   holds.  Lock wait lists are kept in priority order, so this
+   takes time proportional to the number of locks T holds.  Has
+   no effect under MLFQS, which does not donate.  This function
+   must be called with interrupts off. */
+void
+thread_refresh_priority (struct thread *t)
+{
+  struct list_elem *e;
+  int priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (thread_mlfqs)
+    return;
+
+  priority = t->base_priority;
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      int waiter = wait_queue_priority (&lock->semaphore.waiters);
+
+      if (waiter > priority)
+        priority = waiter;
+    }
+  thread_change_priority (t, priority);
+}
+
+/* priority that MLFQS assigns to T from its recent_cpu and nice */
+static int
+mlfqs_priority (struct thread *t)
+{
+    /* some subs here can be denoted with Macro but I don't */
+  int priority = PRI_MAX - 
+                 FP_TO_INT_TRUNC( FP_DIV_INT(t->recent_cpu,4) ) - 
+                 (t->nice*2) ;
+  priority = priority > PRI_MAX ? PRI_MAX : priority;
+  priority = priority < PRI_MIN ? PRI_MIN : priority;
+  return priority;
+}
+
 /* update priority according to nice */
 void
 thread_update_priority_with_nice (struct thread *t)
 {
   ASSERT(thread_mlfqs);
   if(t == idle_thread) return;
-    /* some subs here can be denoted with Macro but I don't */
-  t->priority = PRI_MAX - 
-                FP_TO_INT_TRUNC( FP_DIV_INT(t->recent_cpu,4) ) - 
-                (t->nice*2) ;
-  t->priority = t->priority > PRI_MAX ? PRI_MAX : t->priority;
-  t->priority = t->priority < PRI_MIN ? PRI_MIN : t->priority;
-
-  /* First in first serve 
-    (the first priority in the ready list is to run next) 
-    perform worse than unpredictable list_sort
-  if(t->status==THREAD_READY){
-    list_remove(&t->elem);
-    list_insert_ordered (&ready_list,&t->elem,
-                        thread_priority_large_func,NULL);
-  }
-  */
+  thread_change_priority (t, mlfqs_priority (t));
 }
 
-void thread_update_priority_with_nice_all(void){
-  ASSERT(thread_mlfqs);
-  thread_foreach(thread_update_priority_with_nice,NULL);
+/* Returns COEF raised to the K-th power. */
+static fixed_point
+fp_pow (fixed_point coef, int64_t k)
+{
+  fixed_point result = INT_TO_FP (1);
+
+  for (; k > 0; k >>= 1)
+    {
+      if (k & 1)
+        result = FP_MUL_FP (result, coef);
+      coef = FP_MUL_FP (coef, coef);
+    }
+  return result;
+}
+
+/* Applies every per-second recent_cpu decay that T missed while
+   it was blocked.  Decay coefficients are kept for the last
+   DECAY_HISTORY seconds; seconds older than that are applied in
+   closed form with the oldest kept coefficient C:
+
+      recent_cpu = C^k * recent_cpu + nice * (1 - C^k) / (1 - C)
+
+   The closed form is exact only if load_avg, and so the
+   coefficient, held steady over those K older seconds.  Otherwise
+   its error is at most |recent_cpu| + |nice| * (2 * L + 1), where
+   L is the largest load_avg in that time, and the DECAY_HISTORY
+   exact decays that follow scale it down by the product of their
+   coefficients: by (2/3)^16 < 0.002 at a load_avg of 1, but only
+   by (20/21)^16 = 0.46 at a load_avg of 10.  Threads blocked for
+   DECAY_HISTORY seconds or less catch up exactly, apart from
+   fixed-point rounding.
+
+   Returns true if T's recent_cpu changed. */
+static bool
+recent_cpu_catch_up (struct thread *t)
+{
+  int64_t missed = mlfqs_seconds - t->recent_cpu_seconds;
+  int64_t s;
+
+  if (missed <= 0)
+    return false;
+
+  if (missed > DECAY_HISTORY)
+    {
+      fixed_point c = decay_coef[mlfqs_seconds % DECAY_HISTORY];
+      fixed_point ck = fp_pow (c, missed - DECAY_HISTORY);
+      fixed_point one = INT_TO_FP (1);
+
+      t->recent_cpu = FP_ADD_FP (FP_MUL_FP (ck, t->recent_cpu),
+                                 FP_MUL_INT (FP_DIV_FP (one - ck, one - c),
+                                             t->nice));
+      missed = DECAY_HISTORY;
+    }
+  for (s = mlfqs_seconds - missed; s < mlfqs_seconds; s++)
+    t->recent_cpu = FP_ADD_INT (FP_MUL_FP (decay_coef[s % DECAY_HISTORY],
+                                           t->recent_cpu), t->nice);
+  t->recent_cpu_seconds = mlfqs_seconds;
+  return true;
 }
 
-/* update recent cpu once */
+/* bring T's recent cpu up to date */
 void
 thread_update_recent_cpu(struct thread *t)
 {
   ASSERT(thread_mlfqs);
   if(t == idle_thread) return;
-  fixed_point a = FP_MUL_INT(load_avg,2);
-  fixed_point b = FP_DIV_FP(a,FP_ADD_INT(a,1));
-
-  t->recent_cpu = FP_ADD_INT(FP_MUL_FP(b,t->recent_cpu),t->nice);
+  recent_cpu_catch_up (t);
 }
 
-/* update recent cpu when timer interrupt triggers */
+/* update recent cpu once a second when timer interrupt triggers.
+   Blocked threads are not touched here: they catch up on the
+   missed decay in thread_unblock(), so the work done is bounded
+   by the number of runnable threads.  Ready threads are moved
+   to their new queues in their old queue order, which keeps
+   threads of equal new priority in FIFO order. */
 void
 thread_update_recent_cpu_all()
 {
+  struct list runnable;
+  struct thread *cur = thread_current ();
+  size_t work = 0;
+  int p;
+
   ASSERT(thread_mlfqs);
-  thread_foreach(thread_update_recent_cpu,NULL);
-  thread_update_priority_with_nice_all();
+  ASSERT (intr_get_level () == INTR_OFF);
 
-  /* a choice better predictable and performance */
-  list_sort(&ready_list,thread_priority_large_func,NULL);
+  fixed_point a = FP_MUL_INT(load_avg,2);
+  decay_coef[mlfqs_seconds % DECAY_HISTORY] = FP_DIV_FP(a,FP_ADD_INT(a,1));
+  mlfqs_seconds++;
+
+  list_init (&runnable);
+  for (p = PRI_MAX; p >= PRI_MIN; p--)
+    while (!list_empty (&ready_queues[p - PRI_MIN]))
+      list_push_back (&runnable, list_pop_front (&ready_queues[p - PRI_MIN]));
+  ready_mask = 0;
+  ready_cnt = 0;
+
+  while (!list_empty (&runnable))
+    {
+      struct thread *t = list_entry (list_pop_front (&runnable),
+                                     struct thread, elem);
+      recent_cpu_catch_up (t);
+      t->priority = mlfqs_priority (t);
+      ready_queue_push (t);
+      work++;
+    }
+
+  if (cur != idle_thread)
+    {
+      recent_cpu_catch_up (cur);
+      cur->priority = mlfqs_priority (cur);
+      work++;
+    }
+
+  if (work > mlfqs_max_work)
+    mlfqs_max_work = work;
+}
+
+/* Returns the largest number of threads visited by a single
+   per-second MLFQS update since the last reset. */
+size_t
+thread_mlfqs_max_work (void)
+{
+  return mlfqs_max_work;
+}
+
+/* Resets the counter returned by thread_mlfqs_max_work(). */
+void
+thread_mlfqs_reset_max_work (void)
+{
+  enum intr_level old_level = intr_disable ();
+  mlfqs_max_work = 0;
+  intr_set_level (old_level);
 }
 
 /* update load_avg when timer interrupt triggers */
@@ -429,7 +625,7 @@ update_load_avg()
 {
   ASSERT(thread_mlfqs);
 
-  int co = list_size(&ready_list);
+  int co = ready_cnt;
   if(thread_current()!=idle_thread) co++;
   fixed_point a = FP_MUL_FP(FP_DIV_INT(INT_TO_FP(59), 60),load_avg);
   fixed_point b = FP_MUL_INT(FP_DIV_INT(INT_TO_FP(1), 60),co);
@@ -455,9 +651,7 @@ thread_set_nice (int nice)
   cur->nice = nice;
   thread_update_priority_with_nice(cur);
   /* yield if the priority is not highest */
-  if(!list_empty(&ready_list) && 
-    list_entry(list_front(&ready_list),
-              struct thread,elem)->priority > cur->priority){
+  if(ready_queue_highest () > cur->priority){
       thread_yield();
   }
 }
@@ -508,6 +702,18 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Zero pages for PAL_ZERO requests while there is nothing
+         else to do. */
+      intr_enable ();
+      while (ready_cnt == 0 && palloc_zero_idle ())
+        continue;
+      intr_disable ();
+      if (ready_cnt > 0)
+        continue;
+
+      /* Stop the periodic tick if nothing needs it soon. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -574,12 +780,15 @@ init_thread (struct thread *t, const char *name, int priority)
 
   /* ============================ project 1 =============================*/
   t->priority = priority;
-  t->priority_lock_master=NULL;
-  t->stored_index = 0;
+  t->base_priority = priority;
+  list_init (&t->held_locks);
+  t->waiting_lock = NULL;
+  t->wait_queue = NULL;
 
   if(thread_mlfqs){
     t->nice = 0;
     t->recent_cpu = INT_TO_FP(0);
+    t->recent_cpu_seconds = mlfqs_seconds;
   }
 
   /* ============================ project 2 =============================*/
@@ -588,8 +797,7 @@ init_thread (struct thread *t, const char *name, int priority)
 
   t->magic = THREAD_MAGIC;
   old_level = intr_disable ();
-  list_insert_ordered (&all_list, &t->allelem, 
-                      thread_priority_large_func, NULL);
+  list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
 }
 
@@ -614,10 +822,55 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int priority = ready_queue_highest ();
+  struct thread *t;
+
+  if (priority < PRI_MIN)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  t = list_entry (list_front (&ready_queues[priority - PRI_MIN]),
+                  struct thread, elem);
+  ready_queue_remove (t);
+  return t;
+}
+
+/* Appends T to the ready queue for its priority. */
+static void
+ready_queue_push (struct thread *t)
+{
+  int idx = t->priority - PRI_MIN;
+
+  list_push_back (&ready_queues[idx], &t->elem);
+  ready_mask |= (uint64_t) 1 << idx;
+  ready_cnt++;
+}
+
+/* Removes T from the ready queue for its priority. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int idx = t->priority - PRI_MIN;
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[idx]))
+    ready_mask &= ~((uint64_t) 1 << idx);
+  ready_cnt--;
+}
+
+/* Returns the highest priority among ready threads, or
+   PRI_MIN - 1 if no thread is ready.  Scans the two halves of
+   ready_mask separately so that only 32-bit BSR is needed. */
+static int
+ready_queue_highest (void)
+{
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  if (high != 0)
+    return PRI_MIN + 63 - __builtin_clz (high);
+  if (low != 0)
+    return PRI_MIN + 31 - __builtin_clz (low);
+  return PRI_MIN - 1;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -649,6 +902,10 @@ thread_schedule_tail (struct thread *prev)
   /* Start new time slice. */
   thread_ticks = 0;
 
+  /* Leaving the idle thread: bring the tick back. */
+  if (prev == idle_thread && cur != idle_thread)
+    timer_idle_exit ();
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
@@ -4,7 +4,9 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/timer.h"
 #include "threads/fixed-point.h"
+#include "threads/malloc.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -93,22 +95,22 @@ struct thread
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 /* =============================== project 1 =============================== */
-    /* Record the alarm pos and wake-up time */
-    int64_t wake_up_time;
-    struct list_elem alarm_elem;
-
-    int priority;                        /* Current Priority. */
-    /* Pair Lock to this priority; NULL if it is default */
-    struct lock *priority_lock_master;   
-    /* Priority donated by other threads;
-      we also save the donation's belonging lock */
-    int stored_priority[30];
-    struct lock *stored_lock_master[30];
-    int stored_index;
+    /* Alarm that wakes the thread from timer_sleep() */
+    struct alarm alarm;
+
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority without donations. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for. */
+    struct wait_queue *wait_queue;      /* Wait queue blocked on, if any. */
+    bool wait_head;                     /* Represents its priority bucket? */
+    struct list wait_bucket;            /* Later waiters at our priority. */
 
     /* nice and recent_cpu */
     int nice;
     fixed_point recent_cpu;
+    int64_t recent_cpu_seconds;         /* MLFQS second recent_cpu is
+                                           decayed up to. */
 /* =============================== project 2 =============================== */
     /* exit code when a user process terminates */
     int ret;
@@ -121,6 +123,9 @@ struct thread
     uint32_t *pagedir;                  /* Page directory. */
 #endif
 
+    /* Owned by threads/malloc.c. */
+    struct magazine *magazines;         /* Cached free blocks, or null. */
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -134,6 +139,7 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_tick_idle (int64_t cnt);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -155,10 +161,11 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_change_priority (struct thread *, int);
+void thread_refresh_priority (struct thread *);
 
 /* ====== Project 1 Advanced scheduler ============ */
 void thread_update_priority_with_nice (struct thread *t);
-void thread_update_priority_with_nice_all(void);
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
@@ -168,6 +175,8 @@ void update_load_avg(void);
 void thread_ins_recent_cpu(void);
 void thread_update_recent_cpu(struct thread *t);
 void thread_update_recent_cpu_all(void);
+size_t thread_mlfqs_max_work (void);
+void thread_mlfqs_reset_max_work (void);
 /* ====== Project 1 Advanced scheduler ============ */
 
 /* return true if thread a's priority > thread b's */